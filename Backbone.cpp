@@ -0,0 +1,241 @@
+#include "Backbone.h"
+#include "Instrumentation.h"
+#include <iostream>
+#include <random>
+
+using namespace std;
+
+
+BackboneAnalysis::BackboneAnalysis(int size) : size(size), n(0), n_top(0), n_bottom(0) {
+	/*Allocate everything once, for the biggest possible cluster. S & T are the 2 extra vertices.*/
+
+	int n_sites = size*size;
+	int n_edges = 2 * n_sites + 2 * size; // Bonds of the lattice, plus the edges to S & T.
+	id = new int[n_sites];
+	site = new int[n_sites];
+	top = new int[size];
+	bottom = new int[size];
+	disc = new int[n_sites + 2];
+	low = new int[n_sites + 2];
+	parent = new int[n_sites + 2];
+	next_edge = new int[n_sites + 2];
+	holds_T = new bool[n_sites + 2];
+	on_backbone = new bool[n_sites + 2];
+	stack = new int[n_sites + 2];
+	edge_stack = new int[2 * n_edges];
+
+	for (int i = 0; i < n_sites; i++) id[i] = -1;
+}
+
+BackboneAnalysis::~BackboneAnalysis() {
+	delete[] id;
+	delete[] site;
+	delete[] top;
+	delete[] bottom;
+	delete[] disc;
+	delete[] low;
+	delete[] parent;
+	delete[] next_edge;
+	delete[] holds_T;
+	delete[] on_backbone;
+	delete[] stack;
+	delete[] edge_stack;
+}
+
+bool BackboneAnalysis::connected(Workspace &W, int a, int b) {
+	BondLattice* B = W.get_bonds();
+	if (B == NULL) return true;
+	if (a > b) swap(a, b);
+	if (b == a + 1) return B->horizontal_open(a / size, a % size);
+	return B->vertical_open(a / size, a % size);
+}
+
+int BackboneAnalysis::degree(int u) {
+	if (u == n) return n_top;
+	if (u == n + 1) return n_bottom;
+	return 6; // 4 neighbours on the lattice, then S & T.
+}
+
+int BackboneAnalysis::neighbour(Workspace &W, int u, int k) {
+	/* Only sites already numbered by collect are in the cluster. */
+
+	if (u == n) return top[k];
+	if (u == n + 1) return bottom[k];
+
+	int s = site[u];
+	int x = s / size, y = s % size;
+	int t;
+	switch (k) {
+	case 0: if (x == 0) return -1; t = s - size; break;
+	case 1: if (x == size - 1) return -1; t = s + size; break;
+	case 2: if (y == 0) return -1; t = s - 1; break;
+	case 3: if (y == size - 1) return -1; t = s + 1; break;
+	case 4: return x == 0 ? n : -1;
+	default: return x == size - 1 ? n + 1 : -1;
+	}
+	if (id[t] < 0 || !connected(W, s, t)) return -1;
+	return id[t];
+}
+
+
+
+int BackboneAnalysis::collect(Workspace &W, int spanning_cluster) {
+	/* Breadth-first search from the whole top row of the cluster at once. site[] is the queue, and each frontier is the stretch of it
+		numbered in the previous level, so the first level to reach the bottom row is the chemical distance.
+		A site joined to a site of the cluster is in the cluster, so only the top row needs its label checked. */
+
+	int label, s, t, x, y;
+	int chemical_distance = -1;
+
+	n = 0;
+	n_top = 0;
+	n_bottom = 0;
+	for (y = 0; y < size; y++) {
+		label = W.get_site(0, y);
+		if (label == 0 || W.find(label) != spanning_cluster) continue;
+		id[y] = n;
+		site[n] = y;
+		top[n_top++] = n;
+		n++;
+	}
+
+	int begin = 0, end = n; // The current frontier.
+	for (int level = 0; begin < end; level++) {
+		for (int i = begin; i < end; i++) {
+			s = site[i];
+			x = s / size;
+			y = s % size;
+			if (x == size - 1) {
+				bottom[n_bottom++] = i;
+				if (chemical_distance < 0) chemical_distance = level;
+			}
+
+			int targets[N_NEIGHBOURS] = { x != 0 ? s - size : -1, x != size - 1 ? s + size : -1, y != 0 ? s - 1 : -1, y != size - 1 ? s + 1 : -1 };
+			for (int k = 0; k < N_NEIGHBOURS; k++) {
+				t = targets[k];
+				if (t < 0 || id[t] >= 0 || W.get_site(t / size, t % size) == 0 || !connected(W, s, t)) continue;
+				id[t] = n;
+				site[n] = t;
+				n++;
+			}
+		}
+		begin = end;
+		end = n;
+	}
+
+	return chemical_distance;
+}
+
+void BackboneAnalysis::components(Workspace &W, BackboneResult &result) {
+	/* Hopcroft-Tarjan, with the recursion kept on stack. Each edge goes on edge_stack when it's first seen from its later end.
+		When a vertex u is finished & low[u] >= disc[parent], nothing below u reaches above the parent, so the edges from (parent, u) up
+		are a biconnected component. It's on every path from S to T exactly when T is below u. */
+
+	int n_vertices = n + 2;
+	for (int v = 0; v < n_vertices; v++) {
+		disc[v] = -1;
+		parent[v] = -1;
+		next_edge[v] = 0;
+		holds_T[v] = false;
+		on_backbone[v] = false;
+	}
+	holds_T[n + 1] = true;
+
+	int time = 0, depth = 0, n_edge_stack = 0;
+	int u, w, p;
+	disc[n] = low[n] = time++;
+	stack[depth++] = n;
+
+	while (depth > 0) {
+		u = stack[depth - 1];
+
+		if (next_edge[u] < degree(u)) {
+			w = neighbour(W, u, next_edge[u]++);
+			if (w < 0 || w == parent[u]) continue;
+			if (disc[w] < 0) { // Tree edge
+				parent[w] = u;
+				disc[w] = low[w] = time++;
+				edge_stack[n_edge_stack++] = u;
+				edge_stack[n_edge_stack++] = w;
+				stack[depth++] = w;
+			}
+			else if (disc[w] < disc[u]) { // Back edge, seen from its lower end
+				edge_stack[n_edge_stack++] = u;
+				edge_stack[n_edge_stack++] = w;
+				if (disc[w] < low[u]) low[u] = disc[w];
+			}
+			continue;
+		}
+
+		// u is finished.
+		depth--;
+		p = parent[u];
+		if (p < 0) continue;
+		if (low[u] < low[p]) low[p] = low[u];
+		holds_T[p] = holds_T[p] || holds_T[u];
+		if (low[u] < disc[p]) continue;
+
+		// The edges from (p,u) up are a component.
+		int n_component = 0, a, b;
+		bool lattice_bond = false;
+		do {
+			b = edge_stack[--n_edge_stack];
+			a = edge_stack[--n_edge_stack];
+			n_component++;
+			if (holds_T[u]) {
+				on_backbone[a] = true;
+				on_backbone[b] = true;
+			}
+			lattice_bond = a < n && b < n;
+		} while (a != p || b != u);
+
+		if (holds_T[u] && n_component == 1 && lattice_bond) result.red_bonds++;
+	}
+
+	for (int v = 0; v < n; v++) {
+		if (on_backbone[v]) result.backbone++;
+	}
+}
+
+BackboneResult BackboneAnalysis::analyse(Workspace &W, int spanning_cluster) {
+	/* Only the entries of id set by collect are cleared afterwards, so the whole analysis is O(cluster size). */
+
+	BackboneResult result = { 0, 0, 0, 0, 0 };
+	if (spanning_cluster == 0) return result;
+	if (W.get_size() != size) {
+		cout << "ERROR: Workspace is not the same size as the analysis" << endl;
+		return result;
+	}
+
+	INSTRUMENT_PHASE_BEGIN(PHASE_MEASURE);
+	result.chemical_distance = collect(W, spanning_cluster);
+	result.cluster_size = n;
+	components(W, result);
+	result.dangling = n - result.backbone;
+
+	for (int i = 0; i < n; i++) id[site[i]] = -1;
+	INSTRUMENT_PHASE_END(PHASE_MEASURE);
+
+	return result;
+}
+
+
+
+void ensemble_backbone(BackboneResult* data, int size, double p, int nens, mt19937 &mt_rand, int mode) {
+	/* Same as ensemble_F, but keeps the analysis of each spanning cluster instead of F. */
+
+	Workspace W(size, mode);
+	BackboneAnalysis A(size);
+	double F;
+	int i = 0;
+
+	while (i < nens) {
+		F = mode == BOND_MODE ? bond_F_calculation(W, p, mt_rand) : F_calculation(W, p, mt_rand);
+		if (F > 0) {
+			data[i] = A.analyse(W, find_spanning_cluster(W));
+			i++;
+		}
+		else INSTRUMENT_COUNT(REJECTED_LATTICES, 1);
+		INSTRUMENT_POLL();
+	}
+}
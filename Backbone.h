@@ -0,0 +1,58 @@
+#pragma once
+#include "Workspace.h"
+#include <random>
+
+// Transport structure of the spanning cluster, between the top & bottom edges.
+// The top row of the cluster is joined to a virtual source S, and the bottom row to a virtual sink T.
+//	Backbone: the sites on some path from S to T that never visits a site twice, ie. the sites current can flow through.
+//	Dangling ends: the rest of the spanning cluster.
+//	Red bonds: bonds of the lattice that every path from S to T goes through, so cutting any one of them stops the current.
+//	Chemical distance: the fewest bonds on a path from the top row to the bottom row.
+//
+// Everything is found from the labels in a Workspace, in time & memory proportional to the size of the spanning cluster:
+// a breadth-first search from the top row, 1 frontier at a time, finds the cluster, numbers its sites compactly & measures the chemical distance.
+// Then a depth-first search from S, kept on an explicit stack, splits the cluster into biconnected components (Hopcroft-Tarjan).
+// Every simple path from S to T goes through the same components, which are the ones whose subtree holds T, so those make up the backbone,
+// and the components on it that are a single bond of the lattice are the red bonds.
+
+struct BackboneResult {
+	int cluster_size; // Sites in the spanning cluster, or 0 if nothing spans.
+	int backbone; // Sites in the backbone.
+	int dangling; // Sites in the dangling ends.
+	int red_bonds; // Number of red bonds.
+	int chemical_distance; // Fewest bonds between the top & bottom rows.
+};
+
+class BackboneAnalysis
+{
+private:
+
+	int size; // Length of each side of the lattice.
+	int n; // Sites in the spanning cluster. S is vertex n, and T is vertex n+1.
+	int* id; // Compact number of each site of the spanning cluster, x*size+y, or -1. Only the cluster's own entries are ever set, and they're cleared after each analysis.
+	int* site; // x*size+y of each compact site. Sites are numbered in the order the breadth-first search reaches them, so this is also its queue of frontiers.
+	int* top; // Compact numbers of the cluster's sites on the top row. The neighbours of S.
+	int* bottom; // Compact numbers of the cluster's sites on the bottom row. The neighbours of T.
+	int n_top, n_bottom;
+
+	int* disc; // Order in which the depth-first search reached each vertex, or -1.
+	int* low; // Smallest disc reachable from the vertex's subtree by 1 edge that isn't in the tree.
+	int* parent; // Parent in the depth-first tree, or -1.
+	int* next_edge; // Next neighbour of each vertex the depth-first search will look at.
+	bool* holds_T; // Whether T is in the vertex's subtree.
+	bool* on_backbone; // Whether the vertex is in a component on the backbone.
+	int* stack; // The depth-first path.
+	int* edge_stack; // Edges not yet put in a component, as pairs of vertices.
+
+	bool connected(Workspace &W, int a, int b); // Whether neighbouring sites a & b are joined: always in site mode, if the bond between them is open in bond mode.
+	int neighbour(Workspace &W, int u, int k); // The k'th neighbour of vertex u in the cluster, or -1 if there isn't one.
+	int degree(int u); // How many k to try in neighbour.
+	int collect(Workspace &W, int spanning_cluster); // Finds the cluster & numbers it by breadth-first search. Returns the chemical distance.
+	void components(Workspace &W, BackboneResult &result); // The depth-first search, counting the backbone & red bonds.
+public:
+	BackboneAnalysis(int size); // Allocates everything for lattices of this size.
+	~BackboneAnalysis(); // Releases everything.
+	BackboneResult analyse(Workspace &W, int spanning_cluster); // Analyses the cluster with proper label spanning_cluster in W. All 0 if it's 0.
+};
+
+void ensemble_backbone(BackboneResult* data, int size, double p, int nens, std::mt19937 &mt_rand, int mode = SITE_MODE); // Stores the analysis of nens lattices with a spanning cluster into data, made the same way as F_calculation(Workspace&) (or bond_F_calculation in BOND_MODE).
@@ -0,0 +1,297 @@
+#include "Batch.h"
+#include "Instrumentation.h"
+#include <iostream>
+#include <random>
+
+using namespace std;
+
+
+const short UNOCCUPIED = 0x7fff; // Larger than any label or time, and OR-ing it into a label that's >= 0 gives itself.
+
+
+LatticeBatch::LatticeBatch(int size) : size(size), P(size + 2), n_padded((size + 2)*(size + 2)) {
+	/*Allocate everything once for the whole ensemble.*/
+	labels = new short[n_padded][LANES];
+	masks = new short[n_padded][LANES];
+	edges = new unsigned char[n_padded][LANES];
+	times = new short[n_padded][LANES];
+	top_bottom = new short[n_padded][LANES];
+	left_right = new short[n_padded][LANES];
+	order = new int[size*size];
+}
+
+LatticeBatch::~LatticeBatch() {
+	delete[] labels;
+	delete[] masks;
+	delete[] edges;
+	delete[] times;
+	delete[] top_bottom;
+	delete[] left_right;
+	delete[] order;
+}
+
+int LatticeBatch::get_size() {
+	return size;
+}
+
+int LatticeBatch::index(int x, int y) {
+	return (x + 1)*P + y + 1;
+}
+
+
+
+int LatticeBatch::F_calculation(const double p, mt19937 &mt_rand, double F[LANES]) {
+	/* Fill every lane, in the same order as F_calculation, then propagate the smallest label through every cluster of every lane at once.
+		Unoccupied sites & the padding are UNOCCUPIED, and their mask keeps them that way, so they never pass a label on. */
+
+	if (p < 0 || p > 1) {
+		cout << "ERROR: p must be a double in the range [0,1]" << endl;
+		for (int l = 0; l < LANES; l++) F[l] = -1;
+		return 0;
+	}
+
+	int n_occupied[LANES] = { 0 };
+	uniform_real_distribution<double> unit(0, 1);
+	int i;
+
+	INSTRUMENT_PHASE_BEGIN(PHASE_GENERATE);
+	for (i = 0; i < n_padded; i++) {
+		for (int l = 0; l < LANES; l++) {
+			labels[i][l] = UNOCCUPIED;
+			masks[i][l] = UNOCCUPIED;
+		}
+	}
+	for (int l = 0; l < LANES; l++) {
+		for (int x = 0; x < size; x++) {
+			for (int y = 0; y < size; y++) {
+				if (unit(mt_rand) <= p) {
+					i = index(x, y);
+					labels[i][l] = (short)i;
+					masks[i][l] = 0;
+					n_occupied[l]++;
+				}
+			}
+		}
+	}
+	INSTRUMENT_PHASE_END(PHASE_GENERATE);
+
+	// Forward & backward sweeps, so a label travels as far as it can in either direction on every sweep.
+	// Each site's new labels go through a local array, so the compiler knows they can't overlap the neighbours, and vectorises the lanes without checks.
+	INSTRUMENT_PHASE_BEGIN(PHASE_LABEL);
+	short v[LANES];
+	int changed = 1;
+	int first = index(0, 0), last = index(size - 1, size - 1);
+	while (changed) {
+		changed = 0;
+		for (int pass = 0; pass < 2; pass++) {
+			for (int k = 0; k < size*size; k++) {
+				i = pass == 0 ? first + k / size * P + k % size : last - k / size * P - k % size;
+				const short* c = labels[i];
+				const short* up = labels[i - P];
+				const short* down = labels[i + P];
+				const short* left = labels[i - 1];
+				const short* right = labels[i + 1];
+				const short* m = masks[i];
+				for (int l = 0; l < LANES; l++) {
+					v[l] = c[l];
+					if (up[l] < v[l]) v[l] = up[l];
+					if (down[l] < v[l]) v[l] = down[l];
+					if (left[l] < v[l]) v[l] = left[l];
+					if (right[l] < v[l]) v[l] = right[l];
+					v[l] |= m[l];
+					changed |= v[l] != c[l];
+				}
+				for (int l = 0; l < LANES; l++) labels[i][l] = v[l];
+			}
+		}
+	}
+	INSTRUMENT_PHASE_END(PHASE_LABEL);
+
+	// Every cluster is labelled by its smallest site now. Collect the edges of each one from the sites on the edges.
+	INSTRUMENT_PHASE_BEGIN(PHASE_MEASURE);
+	INSTRUMENT_COUNT(SPANNING_CHECKS, LANES);
+	INSTRUMENT_COUNT(EDGE_SITES_SCANNED, 4 * size * LANES);
+	short spanning_label[LANES];
+	int x, y;
+	for (int l = 0; l < LANES; l++) {
+		for (int pass = 0; pass < 2; pass++) { // Clear, then fill.
+			for (int k = 0; k < 4 * size; k++) {
+				x = k < size ? 0 : k < 2 * size ? size - 1 : k % size;
+				y = k < 2 * size ? k % size : k < 3 * size ? 0 : size - 1;
+				short label = labels[index(x, y)][l];
+				if (label == UNOCCUPIED) continue;
+				if (pass == 0) edges[label][l] = 0;
+				else edges[label][l] |= edge_mask(x, y, size);
+			}
+		}
+
+		spanning_label[l] = -1; // Matches no site.
+		for (y = 0; y < size; y++) {
+			short label = labels[index(0, y)][l];
+			if (label != UNOCCUPIED && edges[label][l] == ALL_EDGES) {
+				spanning_label[l] = label;
+				break;
+			}
+		}
+	}
+
+	// Size of each spanning cluster, for every lane at once.
+	int spanning_size[LANES] = { 0 };
+	for (x = 0; x < size; x++) {
+		for (i = index(x, 0); i < index(x, size); i++) {
+			for (int l = 0; l < LANES; l++) spanning_size[l] += labels[i][l] == spanning_label[l];
+		}
+	}
+
+	int n_spanning = 0;
+	for (int l = 0; l < LANES; l++) {
+		if (spanning_label[l] < 0) F[l] = -1;
+		else {
+			F[l] = (double)spanning_size[l] / n_occupied[l];
+			n_spanning++;
+		}
+	}
+	INSTRUMENT_PHASE_END(PHASE_MEASURE);
+
+	return n_spanning;
+}
+
+
+
+void LatticeBatch::minimax(short (*reach)[LANES], bool from_top) {
+	/* reach of a site = the earliest time a path from the edge to it is fully occupied = max(its own time, smallest reach of its neighbours).
+		The padding next to the starting edge has reach 0, so the sites on that edge just get their own time. The rest of the padding never connects. */
+
+	for (int i = 0; i < n_padded; i++) {
+		for (int l = 0; l < LANES; l++) reach[i][l] = UNOCCUPIED;
+	}
+	for (int k = 0; k < size; k++) {
+		int i = from_top ? index(-1, k) : index(k, -1);
+		for (int l = 0; l < LANES; l++) reach[i][l] = 0;
+	}
+
+	short v[LANES];
+	int i, changed = 1;
+	int first = index(0, 0), last = index(size - 1, size - 1);
+	while (changed) {
+		changed = 0;
+		for (int pass = 0; pass < 2; pass++) {
+			for (int k = 0; k < size*size; k++) {
+				i = pass == 0 ? first + k / size * P + k % size : last - k / size * P - k % size;
+				const short* c = reach[i];
+				const short* up = reach[i - P];
+				const short* down = reach[i + P];
+				const short* left = reach[i - 1];
+				const short* right = reach[i + 1];
+				const short* t = times[i];
+				for (int l = 0; l < LANES; l++) {
+					v[l] = up[l];
+					if (down[l] < v[l]) v[l] = down[l];
+					if (left[l] < v[l]) v[l] = left[l];
+					if (right[l] < v[l]) v[l] = right[l];
+					if (t[l] > v[l]) v[l] = t[l];
+					changed |= v[l] != c[l];
+				}
+				for (int l = 0; l < LANES; l++) reach[i][l] = v[l];
+			}
+		}
+	}
+}
+
+void LatticeBatch::generate_lattice(mt19937 &mt_rand, double pc[LANES]) {
+	/* Give every site of every lane a time from a random order, then find the first time each lane has a top-bottom & a left-right path.
+		A top-bottom & a left-right path always share a site, so that's the first time a cluster touches all 4 edges. */
+
+	int n_sites = size*size;
+
+	INSTRUMENT_PHASE_BEGIN(PHASE_GENERATE);
+	for (int i = 0; i < n_padded; i++) {
+		for (int l = 0; l < LANES; l++) times[i][l] = UNOCCUPIED;
+	}
+	int j, site;
+	for (int l = 0; l < LANES; l++) {
+		// Fisher-Yates: the k'th site of the shuffled order is occupied at time k+1.
+		for (int k = 0; k < n_sites; k++) order[k] = k;
+		for (int k = n_sites - 1; k > 0; k--) {
+			j = random(mt_rand, k + 1);
+			site = order[k];
+			order[k] = order[j];
+			order[j] = site;
+		}
+		for (int k = 0; k < n_sites; k++) times[index(order[k] / size, order[k] % size)][l] = (short)(k + 1);
+	}
+	INSTRUMENT_PHASE_END(PHASE_GENERATE);
+
+	INSTRUMENT_PHASE_BEGIN(PHASE_LABEL);
+	minimax(top_bottom, true);
+	minimax(left_right, false);
+	INSTRUMENT_PHASE_END(PHASE_LABEL);
+
+	// First time for each direction = the smallest reach on the far edge.
+	short first_top_bottom[LANES], first_left_right[LANES];
+	for (int l = 0; l < LANES; l++) {
+		first_top_bottom[l] = UNOCCUPIED;
+		first_left_right[l] = UNOCCUPIED;
+	}
+	for (int k = 0; k < size; k++) {
+		const short* bottom = top_bottom[index(size - 1, k)];
+		const short* right = left_right[index(k, size - 1)];
+		for (int l = 0; l < LANES; l++) {
+			if (bottom[l] < first_top_bottom[l]) first_top_bottom[l] = bottom[l];
+			if (right[l] < first_left_right[l]) first_left_right[l] = right[l];
+		}
+	}
+
+	for (int l = 0; l < LANES; l++) {
+		pc[l] = (double)(first_top_bottom[l] > first_left_right[l] ? first_top_bottom[l] : first_left_right[l]) / n_sites;
+	}
+}
+
+
+
+void batch_ensemble_F(double* data, int size, double p, int nens, mt19937 &mt_rand) {
+	/* Same as ensemble_F. The lattices that span are kept in lane order, so the data is the same as ensemble_F's. Lanes left over at the end are dropped. */
+
+	if (size < 1 || size > MAX_BATCH_SIZE) { // Too big for a batch.
+		ensemble_F(data, size, p, nens, mt_rand);
+		return;
+	}
+
+	LatticeBatch B(size);
+	double F[LANES];
+	int i = 0;
+
+	while (i < nens) {
+		B.F_calculation(p, mt_rand, F);
+		for (int l = 0; l < LANES && i < nens; l++) {
+			if (F[l] > 0) {
+				data[i] = F[l];
+				i++;
+			}
+			else INSTRUMENT_COUNT(REJECTED_LATTICES, 1);
+		}
+		INSTRUMENT_POLL();
+	}
+}
+
+void batch_ensemble_lattice(double* data, int size, int nens, mt19937 &mt_rand) {
+	/* Same as ensemble_lattice. */
+
+	if (size < 1 || size > MAX_BATCH_SIZE) { // Too big for a batch.
+		ensemble_lattice(data, size, nens, mt_rand);
+		return;
+	}
+
+	LatticeBatch B(size);
+	double pc[LANES];
+	int i = 0;
+
+	while (i < nens) {
+		B.generate_lattice(mt_rand, pc);
+		for (int l = 0; l < LANES && i < nens; l++) {
+			data[i] = pc[l];
+			i++;
+		}
+		INSTRUMENT_POLL();
+	}
+}
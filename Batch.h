@@ -0,0 +1,50 @@
+#pragma once
+#include "Lattice.h"
+#include <random>
+
+// Many small lattices at once, side by side. Every array holds LANES values per site, 1 for each lattice (structure of arrays),
+// so each step of the labelling does the same thing to every lattice, and the inner loops over the lanes are vectorised by the compiler.
+// The values are shorts, so 16 lanes fit in 256 bits. The lattice is padded with a border, so there are no edge checks.
+//
+// F: each occupied site starts with its own index as its label, and every site takes the smallest label around it,
+// sweeping forwards & backwards until nothing changes, so each cluster ends up labelled by its smallest site.
+// Lane l uses the random numbers of the l'th lattice in a row from F_calculation, so batch_ensemble_F gives the same data as ensemble_F.
+//
+// pc: each lane gets a random order to occupy its sites in, and the lattice spans once it has both a top-bottom & a left-right path
+// (2 such paths always cross). The first time there's a top-bottom path is the smallest, over all such paths, of the latest site on the path,
+// which is found for every site at once by the same kind of sweeps. pc = the later of the 2 times / sites, as in generate_lattice.
+// The random orders are made by shuffling, so the pcs are different from generate_lattice's for the same seed, but have the same distribution.
+
+const int LANES = 16; // Lattices per batch.
+const int MAX_BATCH_SIZE = 32; // Padded site indices must fit in a short.
+
+class LatticeBatch
+{
+private:
+
+	int size; // Length of each side of the lattices.
+	int P; // Length of a padded row.
+	int n_padded; // Sites including the padding.
+
+	short (*labels)[LANES]; // F: smallest site index reached so far, or UNOCCUPIED.
+	short (*masks)[LANES]; // F: UNOCCUPIED for an unoccupied site, 0 for an occupied one.
+	unsigned char (*edges)[LANES]; // F: edges touched by the cluster whose smallest site is this one.
+	short (*times)[LANES]; // pc: when each site is occupied, from 1 to size*size.
+	short (*top_bottom)[LANES]; // pc: earliest time there's a path from the top to the site.
+	short (*left_right)[LANES]; // pc: earliest time there's a path from the left to the site.
+	int* order; // pc: scratch for the shuffle.
+
+	int index(int x, int y); // Padded index of (x,y).
+	void minimax(short (*reach)[LANES], bool from_top); // Sweeps until reach holds, for every site, the earliest time it's connected to the top (or left) edge.
+public:
+	LatticeBatch(int size); // Allocates the arrays for lattices of this size. size must be at most MAX_BATCH_SIZE.
+	~LatticeBatch();
+	int get_size(); // Length of each side of the lattices.
+
+	int F_calculation(const double p, std::mt19937 &mt_rand, double F[LANES]); // Saves the F of LANES lattices of occupation probability p into F, -1 for those that don't span. Returns how many span.
+	void generate_lattice(std::mt19937 &mt_rand, double pc[LANES]); // Saves the pc of LANES lattices filled in random order into pc.
+};
+
+void batch_ensemble_F(double* data, int size, double p, int nens, std::mt19937 &mt_rand); // Same as ensemble_F, LANES lattices at a time. Same data for the same random numbers.
+
+void batch_ensemble_lattice(double* data, int size, int nens, std::mt19937 &mt_rand); // Same as ensemble_lattice, LANES lattices at a time.
@@ -0,0 +1,478 @@
+/*Benchmarks for the percolation kernels. Each kernel is timed at several sizes & occupation probabilities, and the results are printed as a table, and optionally saved as JSON.
+Usage: Benchmarks [--seed N] [--json filename] [--quick]
+	--seed N: Seeds every benchmark with N instead of random_device, so that the same lattices are timed on every run. Use this to compare commits.
+	--json filename: Also writes the results to filename as JSON.
+	--quick: Does a tenth of the work, for a quick check.
+Build: g++ -O2 Benchmarks.cpp Bond.cpp Lattice.cpp Point.cpp Observables.cpp Workspace.cpp FixedLattice.cpp Batch.cpp
+*/
+
+#include "Point.h"
+#include "Lattice.h"
+#include "Bond.h"
+#include "Workspace.h"
+#include "FixedLattice.h"
+#include "Batch.h"
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+using namespace std;
+
+
+// Every allocation in the program goes through these, so the number of allocations done by a kernel can be counted.
+static long long n_allocations = 0;
+
+void* operator new(size_t n) {
+	n_allocations++;
+	void* ptr = malloc(n == 0 ? 1 : n);
+	if (ptr == NULL) throw bad_alloc();
+	return ptr;
+}
+
+void* operator new[](size_t n) {
+	n_allocations++;
+	void* ptr = malloc(n == 0 ? 1 : n);
+	if (ptr == NULL) throw bad_alloc();
+	return ptr;
+}
+
+void operator delete(void* ptr) noexcept { free(ptr); }
+void operator delete[](void* ptr) noexcept { free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { free(ptr); }
+
+
+
+struct Result {
+	string kernel; // Name of the kernel
+	int size; // Length of the lattice, or path length for find_proper_label
+	double p; // Occupation probability, or -1 if it doesn't apply
+	long long ops; // Number of times the kernel was called
+	long long sites; // Number of sites the calls covered in total
+	double seconds; // Time taken by all the calls
+	long long allocations; // Allocations done by all the calls
+};
+
+// Timer that also counts allocations, started & stopped around the code being measured.
+class Stopwatch
+{
+private:
+
+	chrono::steady_clock::time_point start_time;
+	long long start_allocations;
+	double seconds; // Total time between starts & stops so far.
+	long long allocations; // Total allocations between starts & stops so far.
+public:
+	Stopwatch() : start_allocations(0), seconds(0), allocations(0) {}
+	void start() { start_allocations = n_allocations; start_time = chrono::steady_clock::now(); }
+	void stop() {
+		seconds += chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+		allocations += n_allocations - start_allocations;
+	}
+	double get_seconds() { return seconds; }
+	long long get_allocations() { return allocations; }
+};
+
+vector<Result> results; // Every result, in the order they were run.
+unsigned int seed; // Every benchmark starts its RNG from this.
+int work = 4000000; // Roughly the number of sites each benchmark covers.
+
+volatile long long sink; // Results of kernels are added here, so that the compiler can't remove the calls.
+
+void report(const string& kernel, int size, double p, long long ops, long long sites, Stopwatch& watch) {
+	/* Save a result, and print it as a row of the table. */
+
+	Result r = { kernel, size, p, ops, sites, watch.get_seconds(), watch.get_allocations() };
+	results.push_back(r);
+
+	cout << left << setw(28) << kernel << right << setw(6) << size << setw(8) << setprecision(4) << p
+		<< setw(12) << setprecision(4) << 1e9 * r.seconds / ops
+		<< setw(12) << setprecision(4) << 1e9 * r.seconds / sites
+		<< setw(14) << setprecision(4) << sites / r.seconds
+		<< setw(12) << setprecision(4) << (double)r.allocations / ops << endl;
+}
+
+int n_ops(int sites_per_op) {
+	/* Number of calls to do, so that each benchmark covers about "work" sites. */
+	int n = work / sites_per_op;
+	return n < 1 ? 1 : n;
+}
+
+int random_labelled_lattice(int L[MAX_SIZE][MAX_SIZE], int size, double p, int* cluster_labels, mt19937 &mt_rand) {
+	/* Occupies each site with probability p, and labels it using the same raster scan as label_bond_lattice, joining it to occupied neighbours to the left & above.
+		Returns the number of labels used. */
+
+	int cluster_ID = 1;
+	cluster_labels[0] = 0;
+	for (int i = 0; i < size; i++) {
+		for (int j = 0; j < size; j++) {
+			L[i][j] = 0;
+			if (!randreal(mt_rand, p)) continue;
+
+			L[i][j] = cluster_ID;
+			cluster_labels[cluster_ID] = 1;
+			cluster_ID++;
+			if (j != 0 && L[i][j - 1] != 0) merge_clusters(cluster_labels, L[i][j - 1], L[i][j]);
+			if (i != 0 && L[i - 1][j] != 0) merge_clusters(cluster_labels, L[i - 1][j], L[i][j]);
+		}
+	}
+	return cluster_ID;
+}
+
+
+
+void bench_find_proper_label(int path_length) {
+	/* Builds many chains of references of length path_length, and times one find_proper_label from the end of each.
+		Path compression flattens the chains, so they're rebuilt between rounds, outside of the timer. */
+
+	const int n_chains = 1024;
+	int n_labels = n_chains * (path_length + 1) + 1;
+	int* cluster_labels = new int[n_labels];
+	int rounds = n_ops(n_chains * path_length) / n_chains + 1;
+	Stopwatch watch;
+
+	for (int r = 0; r < rounds; r++) {
+
+		// Chain k is labels base..base+path_length, where base is the proper label and each label references the one before it.
+		for (int k = 0; k < n_chains; k++) {
+			int base = 1 + k * (path_length + 1);
+			cluster_labels[base] = 1;
+			for (int j = 1; j <= path_length; j++) cluster_labels[base + j] = -(base + j - 1);
+		}
+
+		watch.start();
+		for (int k = 0; k < n_chains; k++) sink += find_proper_label(cluster_labels, (k + 1) * (path_length + 1));
+		watch.stop();
+	}
+
+	report("find_proper_label", path_length, -1, (long long)rounds * n_chains, (long long)rounds * n_chains * path_length, watch);
+	delete[] cluster_labels;
+}
+
+void bench_get_distinct_neighbours(int size, double p) {
+	/* Times get_distinct_neighbours on every site of a labelled lattice. */
+
+	static int L[MAX_SIZE][MAX_SIZE];
+	mt19937 mt_rand(seed);
+	int* cluster_labels = new int[size*size + 1];
+	random_labelled_lattice(L, size, p, cluster_labels, mt_rand);
+	int neighbours[N_NEIGHBOURS];
+	int rounds = n_ops(size*size);
+	Stopwatch watch;
+
+	watch.start();
+	for (int r = 0; r < rounds; r++) {
+		for (int i = 0; i < size; i++)
+			for (int j = 0; j < size; j++) sink += get_distinct_neighbours(L, size, cluster_labels, i, j, neighbours);
+	}
+	watch.stop();
+
+	report("get_distinct_neighbours", size, p, (long long)rounds * size*size, (long long)rounds * size*size, watch);
+	delete[] cluster_labels;
+}
+
+void bench_find_spanning_cluster(int size, double p) {
+	/* Times find_spanning_cluster on the integer lattice & on the lattice of Points, with the same labels. */
+
+	static int L[MAX_SIZE][MAX_SIZE];
+	static Point P[MAX_SIZE][MAX_SIZE];
+	mt19937 mt_rand(seed);
+	int* cluster_labels = new int[size*size + 1];
+	random_labelled_lattice(L, size, p, cluster_labels, mt_rand);
+	initialise_lattice(P, size);
+	for (int i = 0; i < size; i++)
+		for (int j = 0; j < size; j++) P[i][j].set_val(L[i][j]);
+
+	int rounds = n_ops(4 * size);
+	Stopwatch watch;
+	watch.start();
+	for (int r = 0; r < rounds; r++) sink += find_spanning_cluster(L, size, cluster_labels);
+	watch.stop();
+	report("find_spanning_cluster", size, p, rounds, (long long)rounds * 4 * size, watch);
+
+	Stopwatch point_watch;
+	point_watch.start();
+	for (int r = 0; r < rounds; r++) sink += find_spanning_cluster(P, size, cluster_labels);
+	point_watch.stop();
+	report("find_spanning_cluster/Point", size, p, rounds, (long long)rounds * 4 * size, point_watch);
+
+	delete[] cluster_labels;
+}
+
+void bench_bfs(int size, double p) {
+	/* Times the bfs pass of F_calculation: every site gets its own label, then bfs links them up. The lattice is rebuilt between rounds, outside of the timer. */
+
+	static Point P[MAX_SIZE][MAX_SIZE];
+	mt19937 mt_rand(seed);
+	int* cluster_labels = new int[size*size + 1];
+	int rounds = n_ops(size*size);
+	Stopwatch watch;
+
+	for (int r = 0; r < rounds; r++) {
+
+		initialise_lattice(P, size);
+		int cluster_ID = 1;
+		for (int i = 0; i < size; i++) {
+			for (int j = 0; j < size; j++) {
+				if (randreal(mt_rand, p)) {
+					P[i][j].set_val(cluster_ID);
+					cluster_ID++;
+				}
+			}
+		}
+		for (int i = 0; i < cluster_ID; i++) cluster_labels[i] = 1;
+		cluster_labels[0] = 0;
+
+		watch.start();
+		for (int i = 0; i < size; i++)
+			for (int j = 0; j < size; j++)
+				if (P[i][j].get_val() != 0 && P[i][j].get_colour() == 'w') bfs(P, size, P[i][j], cluster_labels);
+		watch.stop();
+	}
+
+	report("bfs", size, p, rounds, (long long)rounds * size*size, watch);
+	delete[] cluster_labels;
+}
+
+void bench_randreal(double p) {
+	/* Times randreal on its own. Each call is counted as 1 site. */
+
+	mt19937 mt_rand(seed);
+	int calls = n_ops(1);
+	Stopwatch watch;
+
+	watch.start();
+	for (int i = 0; i < calls; i++) sink += randreal(mt_rand, p);
+	watch.stop();
+
+	report("randreal", 1, p, calls, calls, watch);
+}
+
+void bench_generate_lattice(int size) {
+	/* Times whole realizations of generate_lattice, which fills the lattice until it spans. */
+
+	mt19937 mt_rand(seed);
+	int rounds = n_ops(size*size);
+	double total = 0;
+	Stopwatch watch;
+
+	watch.start();
+	for (int r = 0; r < rounds; r++) total += generate_lattice(size, mt_rand);
+	watch.stop();
+	sink += (long long)total;
+
+	report("generate_lattice", size, -1, rounds, (long long)rounds * size*size, watch);
+}
+
+void bench_generate_bond_lattice(int size) {
+	/* Times whole realizations of generate_bond_lattice. */
+
+	mt19937 mt_rand(seed);
+	int rounds = n_ops(size*size);
+	double total = 0;
+	Stopwatch watch;
+
+	watch.start();
+	for (int r = 0; r < rounds; r++) total += generate_bond_lattice(size, mt_rand);
+	watch.stop();
+	sink += (long long)total;
+
+	report("generate_bond_lattice", size, -1, rounds, (long long)rounds * size*size, watch);
+}
+
+void bench_F_calculation(int size, double p) {
+	/* Times whole realizations of F_calculation, spanning or not. */
+
+	mt19937 mt_rand(seed);
+	int rounds = n_ops(size*size);
+	double total = 0;
+	Stopwatch watch;
+
+	watch.start();
+	for (int r = 0; r < rounds; r++) total += F_calculation(size, p, mt_rand);
+	watch.stop();
+	sink += (long long)total;
+
+	report("F_calculation", size, p, rounds, (long long)rounds * size*size, watch);
+}
+
+void bench_workspace(int size, double p) {
+	/* Times F_calculation & generate_lattice reusing one workspace, as the ensemble functions do. The workspace is made outside of the timer. */
+
+	Workspace W(size, SITE_MODE);
+	mt19937 mt_rand(seed);
+	int rounds = n_ops(size*size);
+	double total = 0;
+
+	Stopwatch F_watch;
+	F_watch.start();
+	for (int r = 0; r < rounds; r++) total += F_calculation(W, p, mt_rand);
+	F_watch.stop();
+	report("F_calculation/Workspace", size, p, rounds, (long long)rounds * size*size, F_watch);
+
+	Stopwatch pc_watch;
+	pc_watch.start();
+	for (int r = 0; r < rounds; r++) total += generate_lattice(W, mt_rand);
+	pc_watch.stop();
+	report("generate_lattice/Workspace", size, -1, rounds, (long long)rounds * size*size, pc_watch);
+
+	sink += (long long)total;
+}
+
+template<int L>
+void bench_fixed(double p) {
+	/* Same as bench_workspace, with the kernels compiled for size L. */
+
+	FixedLattice<L>* lattice = new FixedLattice<L>;
+	mt19937 mt_rand(seed);
+	int rounds = n_ops(L*L);
+	double total = 0;
+
+	Stopwatch F_watch;
+	F_watch.start();
+	for (int r = 0; r < rounds; r++) total += lattice->F_calculation(p, mt_rand);
+	F_watch.stop();
+	report("F_calculation/Fixed", L, p, rounds, (long long)rounds * L*L, F_watch);
+
+	Stopwatch pc_watch;
+	pc_watch.start();
+	for (int r = 0; r < rounds; r++) total += lattice->generate_lattice(mt_rand);
+	pc_watch.stop();
+	report("generate_lattice/Fixed", L, -1, rounds, (long long)rounds * L*L, pc_watch);
+
+	sink += (long long)total;
+	delete lattice;
+}
+
+void bench_batch(int size, double p) {
+	/* Times LatticeBatch, counting each lane as 1 realization, so the rows compare directly with the workspace rows. */
+
+	LatticeBatch B(size);
+	mt19937 mt_rand(seed);
+	int rounds = n_ops(size*size*LANES);
+	double values[LANES];
+	double total = 0;
+
+	Stopwatch F_watch;
+	F_watch.start();
+	for (int r = 0; r < rounds; r++) total += B.F_calculation(p, mt_rand, values);
+	F_watch.stop();
+	report("F_calculation/Batch", size, p, (long long)rounds * LANES, (long long)rounds * LANES * size*size, F_watch);
+
+	Stopwatch pc_watch;
+	pc_watch.start();
+	for (int r = 0; r < rounds; r++) {
+		B.generate_lattice(mt_rand, values);
+		total += values[0];
+	}
+	pc_watch.stop();
+	report("generate_lattice/Batch", size, -1, (long long)rounds * LANES, (long long)rounds * LANES * size*size, pc_watch);
+
+	sink += (long long)total;
+}
+
+
+
+bool results_to_json(const char* filename, bool stable) {
+	/* Writes every result to filename as JSON, with the seed, so that runs can be compared. */
+
+	ofstream outfile(filename, ios::out);
+
+	if (!outfile) {
+		cout << "Failed to create file" << endl;
+		return EXIT_FAILURE;
+	}
+
+	outfile << setprecision(10);
+	outfile << "{" << endl;
+	outfile << "  \"seed\": " << seed << "," << endl;
+	outfile << "  \"stable_seed\": " << (stable ? "true" : "false") << "," << endl;
+	outfile << "  \"work\": " << work << "," << endl;
+	outfile << "  \"results\": [" << endl;
+	for (size_t i = 0; i < results.size(); i++) {
+		Result& r = results[i];
+		outfile << "    {\"kernel\": \"" << r.kernel << "\", \"size\": " << r.size << ", \"p\": " << r.p
+			<< ", \"ops\": " << r.ops << ", \"sites\": " << r.sites << ", \"seconds\": " << r.seconds
+			<< ", \"ns_per_op\": " << 1e9 * r.seconds / r.ops
+			<< ", \"ns_per_site\": " << 1e9 * r.seconds / r.sites
+			<< ", \"sites_per_s\": " << r.sites / r.seconds
+			<< ", \"allocations_per_op\": " << (double)r.allocations / r.ops << "}";
+		if (i + 1 < results.size()) outfile << ",";
+		outfile << endl;
+	}
+	outfile << "  ]" << endl;
+	outfile << "}" << endl;
+
+	outfile.close();
+
+	return EXIT_SUCCESS;
+}
+
+
+
+int main(int argc, char** argv) {
+
+	const char* json_filename = NULL;
+	bool stable = false;
+
+	random_device rt;
+	seed = rt();
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+			seed = (unsigned int)strtoul(argv[i + 1], NULL, 10);
+			stable = true;
+			i++;
+		}
+		else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+			json_filename = argv[i + 1];
+			i++;
+		}
+		else if (strcmp(argv[i], "--quick") == 0) work /= 10;
+		else {
+			cout << "Usage: " << argv[0] << " [--seed N] [--json filename] [--quick]" << endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	const int sizes[] = { 16, 32, 64, 100 };
+	const double ps[] = { 0.3, 0.5927, 0.8 };
+	const int path_lengths[] = { 1, 4, 16, 64 };
+
+	cout << "seed = " << seed << (stable ? " (stable)" : "") << endl;
+	cout << left << setw(28) << "kernel" << right << setw(6) << "L" << setw(8) << "p"
+		<< setw(12) << "ns/op" << setw(12) << "ns/site" << setw(14) << "sites/s" << setw(12) << "allocs/op" << endl;
+
+	for (int k : path_lengths) bench_find_proper_label(k);
+	for (double p : ps) bench_randreal(p);
+
+	for (int size : sizes) {
+		for (double p : ps) {
+			bench_get_distinct_neighbours(size, p);
+			bench_find_spanning_cluster(size, p);
+			bench_bfs(size, p);
+			bench_F_calculation(size, p);
+		}
+		bench_workspace(size, 0.5927);
+		if (size <= MAX_BATCH_SIZE) bench_batch(size, 0.5927);
+		bench_generate_lattice(size);
+		bench_generate_bond_lattice(size);
+	}
+
+	// The fixed sizes aren't in sizes, so they get their own workspace rows to compare with.
+	bench_workspace(20, 0.5927);
+	bench_fixed<20>(0.5927);
+	bench_workspace(50, 0.5927);
+	bench_fixed<50>(0.5927);
+
+	if (json_filename != NULL) results_to_json(json_filename, stable);
+
+	return 0;
+}
@@ -0,0 +1,278 @@
+#include "Bond.h"
+#include "Observables.h"
+#include "Instrumentation.h"
+#include "Workspace.h"
+#include <iostream>
+#include <random>
+#include <algorithm>
+
+using namespace std;
+
+
+BondLattice::BondLattice(int size) : size(size) {
+	/*Allocate a plane of size*size bits for each direction, and close every bond.*/
+	n_words = (size*size + BITS_PER_WORD - 1) / BITS_PER_WORD; // Round up, so the last few bonds get a word.
+	horizontal = new unsigned long long[n_words];
+	vertical = new unsigned long long[n_words];
+	clear();
+}
+
+BondLattice::~BondLattice() {
+	/*Release both planes.*/
+	delete[] horizontal;
+	delete[] vertical;
+}
+
+int BondLattice::get_size() {
+	/*Returns the length of each side of the lattice.*/
+	return size;
+}
+
+int BondLattice::n_bonds() {
+	/*Every row has size-1 horizontal bonds, and every column has size-1 vertical bonds.*/
+	return 2 * size * (size - 1);
+}
+
+bool BondLattice::exists(int bond) {
+	/*Horizontal bonds on the right edge & vertical bonds on the bottom edge would leave the lattice.*/
+	if (bond < size*size) return bond % size != size - 1; // Horizontal: y != size - 1
+	return (bond - size*size) / size != size - 1; // Vertical: x != size - 1
+}
+
+void BondLattice::clear() {
+	/*Close every bond, by zeroing both planes.*/
+	for (int i = 0; i < n_words; i++) {
+		horizontal[i] = 0;
+		vertical[i] = 0;
+	}
+}
+
+void BondLattice::fill(double p, mt19937 &mt_rand) {
+	/*Open each existing bond with probability p. Bonds that are already open stay open.*/
+	for (int bond = 0; bond < 2 * size*size; bond++) {
+		if (exists(bond) && randreal(mt_rand, p)) open(bond);
+	}
+}
+
+void BondLattice::open(int bond) {
+	/*Set the bit for bond number "bond" in whichever plane it belongs to.*/
+	if (bond < size*size) horizontal[bond / BITS_PER_WORD] |= 1ULL << (bond % BITS_PER_WORD);
+	else {
+		bond -= size*size;
+		vertical[bond / BITS_PER_WORD] |= 1ULL << (bond % BITS_PER_WORD);
+	}
+}
+
+bool BondLattice::horizontal_open(int x, int y) {
+	/*Reads the bit for the bond (x,y)-(x,y+1).*/
+	int bit = x*size + y;
+	return (horizontal[bit / BITS_PER_WORD] >> (bit % BITS_PER_WORD)) & 1ULL;
+}
+
+bool BondLattice::vertical_open(int x, int y) {
+	/*Reads the bit for the bond (x,y)-(x+1,y).*/
+	int bit = x*size + y;
+	return (vertical[bit / BITS_PER_WORD] >> (bit % BITS_PER_WORD)) & 1ULL;
+}
+
+bool BondLattice::isolated(int x, int y) {
+	/*Checks the bonds to the right & below (owned by (x,y)), and the bonds to the left & above (owned by the neighbours).*/
+	if (horizontal_open(x, y) || vertical_open(x, y)) return false;
+	if (y != 0 && horizontal_open(x, y - 1)) return false;
+	if (x != 0 && vertical_open(x - 1, y)) return false;
+	return true;
+}
+
+
+
+int label_bond_lattice(BondLattice &B, int L[MAX_SIZE][MAX_SIZE], int* cluster_labels) {
+	/* Gives every site that touches an open bond a new label, and then joins it to its left & top neighbours if the bond between them is open.
+		As the lattice is read in order, the neighbours to the left & above already have labels.
+		Isolated sites are left unoccupied (label 0), so that the rest of the site machinery (find_spanning_cluster, spanning_fraction) treats them as empty.
+		cluster_labels must have room for size*size + 1 labels.
+	*/
+
+	int size = B.get_size();
+	int cluster_ID = 1; // Holds the value of the highest cluster not yet initialised.
+
+	for (int i = 0; i < size; i++) { // Every element in row i
+
+		for (int j = 0; j < size; j++) { // Every element in column j
+
+			if (B.isolated(i, j)) {
+				L[i][j] = 0;
+				continue;
+			}
+
+			L[i][j] = cluster_ID;
+			cluster_labels[cluster_ID] = 1; // New cluster of 1 site, which is its own proper label.
+			cluster_ID++;
+
+			// Join along the open bonds to sites that have been labelled already.
+			if (j != 0 && B.horizontal_open(i, j - 1)) merge_clusters(cluster_labels, L[i][j - 1], L[i][j]);
+			if (i != 0 && B.vertical_open(i - 1, j)) merge_clusters(cluster_labels, L[i - 1][j], L[i][j]);
+
+		}
+	}
+
+	return cluster_ID;
+}
+
+
+
+double bond_F_calculation(int size, double p, mt19937 &mt_rand) {
+	/*This creates 1 lattice with bond occupation probability p, calculates F for the spanning cluster in that lattice, and returns it.*/
+
+	int L[MAX_SIZE][MAX_SIZE]; // Labels of the sites.
+	BondLattice B(size);
+	INSTRUMENT_PHASE_BEGIN(PHASE_GENERATE);
+	B.fill(p, mt_rand);
+	INSTRUMENT_PHASE_END(PHASE_GENERATE);
+
+	int* cluster_labels = new int[size*size + 1]; // Needs a place for 0, and a space for each site in the lattice.
+	cluster_labels[0] = 0;
+	INSTRUMENT_PHASE_BEGIN(PHASE_LABEL);
+	int n_labels = label_bond_lattice(B, L, cluster_labels);
+	INSTRUMENT_PHASE_END(PHASE_LABEL);
+
+	// Get the spanning cluster
+	INSTRUMENT_PHASE_BEGIN(PHASE_MEASURE);
+	int spanning_cluster = find_spanning_cluster(L, size, cluster_labels);
+
+	//Error handling if no spanning cluster was made.
+	if (spanning_cluster == 0) {
+		INSTRUMENT_PHASE_END(PHASE_MEASURE);
+		delete[] cluster_labels;
+		return -1;
+	}
+
+	// F from the cluster sizes kept in cluster_labels, the same as for site percolation.
+	FObserver F;
+	ObservablePipeline pipeline;
+	pipeline.add(&F);
+	pipeline.run(cluster_labels, n_labels, spanning_cluster, size*size);
+	INSTRUMENT_PHASE_END(PHASE_MEASURE);
+
+	// Drop dynamic memory.
+	delete[] cluster_labels;
+
+	return F.get_F();
+}
+
+
+
+void ensemble_bond_F(double* data, int size, double p, int nens, mt19937 &mt_rand) {
+	/* Do nens lattice simulations, and store their Fs into an array called data.
+		Every lattice reuses the same workspace, so nothing is allocated or cleared per lattice. */
+
+	int i = 0;
+	double val;
+	Workspace W(size, BOND_MODE);
+
+	// Keep on iterating until we have nens values of F.
+	while (i < nens) {
+		val = bond_F_calculation(W, p, mt_rand);
+		if (val > 0) { //If a spanning cluster has been gotten in this particular case.
+			data[i] = val; //Save the associated F
+			i++;
+		}
+		else INSTRUMENT_COUNT(REJECTED_LATTICES, 1);
+		INSTRUMENT_POLL();
+	}
+
+}
+
+
+
+double generate_bond_lattice(int size, mt19937 &mt_rand) {
+	/* The bond version of generate_lattice. The bonds are opened one at a time in a random order (Newman-Ziff), until a spanning cluster appears.
+		Every site starts off as its own cluster. Each root of cluster_labels also keeps track of which edges its cluster touches,
+		so that checking for a spanning cluster after each bond costs O(1), rather than a call to find_spanning_cluster.
+	*/
+
+	if (size < 2) {
+		cout << "ERROR: Bond lattice needs size > 1" << endl;
+		return -1;
+	}
+
+	int L[MAX_SIZE][MAX_SIZE]; // Every site is labelled, as every site is a cluster in bond percolation.
+	BondLattice B(size);
+
+	int* cluster_labels = new int[size*size + 1]; // A place for 0, and a label for each site.
+	int* edges = new int[size*size + 1]; // edges[c] holds the edges touched by cluster c, while c is a proper label.
+	cluster_labels[0] = 0;
+	edges[0] = 0;
+
+	for (int i = 0; i < size; i++) {
+		for (int j = 0; j < size; j++) {
+			L[i][j] = i*size + j + 1;
+			cluster_labels[L[i][j]] = 1;
+			edges[L[i][j]] = edge_mask(i, j, size);
+		}
+	}
+
+	// Make a list of every bond that exists, to be shuffled as we go.
+	int n_bonds = B.n_bonds();
+	int* order = new int[n_bonds];
+	int n = 0;
+	for (int bond = 0; bond < 2 * size*size; bond++) {
+		if (B.exists(bond)) {
+			order[n] = bond;
+			n++;
+		}
+	}
+
+	int n_open = 0; // Number of bonds opened so far.
+	int bond, site, a, b, new_label;
+
+	// Opening bonds & joining clusters happen together here, so they're both timed as the generate phase.
+	INSTRUMENT_PHASE_BEGIN(PHASE_GENERATE);
+	while (n_open < n_bonds) {
+
+		// Fisher-Yates: pick the next bond at random from the ones not yet opened.
+		swap(order[n_open], order[n_open + random(mt_rand, n_bonds - n_open)]);
+		bond = order[n_open];
+		B.open(bond);
+		n_open++;
+
+		// Get the 2 sites at either end of the bond.
+		site = bond % (size*size);
+		a = L[site / size][site % size];
+		if (bond < size*size) b = L[site / size][site % size + 1]; // Horizontal
+		else b = L[site / size + 1][site % size]; // Vertical
+
+		a = find_proper_label(cluster_labels, a);
+		b = find_proper_label(cluster_labels, b);
+		if (a == b) continue; // Bond inside a cluster, nothing changes.
+
+		new_label = merge_clusters(cluster_labels, a, b);
+		edges[new_label] = edges[a] | edges[b];
+
+		if (edges[new_label] == ALL_EDGES) break; // Spanning cluster found.
+	}
+
+	INSTRUMENT_PHASE_END(PHASE_GENERATE);
+
+	// Release dynamic memory.
+	delete[] cluster_labels;
+	delete[] edges;
+	delete[] order;
+
+	// pc = open bonds / total bonds.
+	return (double)n_open / n_bonds;
+}
+
+
+
+void ensemble_bond_lattice(double* data, int size, int nens, mt19937 &mt_rand) {
+	/* Do nens lattice simulations, and store their pcs into an array called data.
+		Every lattice reuses the same workspace, so nothing is allocated or cleared per lattice. */
+
+	Workspace W(size, BOND_MODE);
+
+	for (int i = 0; i < nens; i++) {
+		data[i] = generate_bond_lattice(W, mt_rand); //Save the associated pc
+		INSTRUMENT_POLL();
+	}
+
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include "Lattice.h"
+#include <random>
+
+// Bond percolation on the same size x size lattice as site percolation.
+// Site (x,y) owns a horizontal bond to (x,y+1) and a vertical bond to (x+1,y). Bond number x*size+y is the horizontal bond of (x,y),
+// and bond number size*size + x*size+y is its vertical bond. Bonds that would leave the lattice never exist.
+
+const int BITS_PER_WORD = 64; // Bonds are packed 64 to an unsigned long long.
+
+class BondLattice
+{
+private:
+
+	int size; // Length of each side of the lattice.
+	int n_words; // Number of words in each plane.
+	unsigned long long* horizontal; // Bit x*size+y is set if the bond (x,y)-(x,y+1) is open.
+	unsigned long long* vertical; // Bit x*size+y is set if the bond (x,y)-(x+1,y) is open.
+public:
+	BondLattice(int size); // Allocates both planes, with every bond closed.
+	~BondLattice(); // Releases both planes.
+	int get_size(); // Gets the length of each side of the lattice.
+	int n_bonds(); // Number of bonds that exist in the lattice, 2*size*(size-1).
+	bool exists(int bond); // False for the bonds that would leave the lattice.
+	void clear(); // Closes every bond.
+	void fill(double p, std::mt19937 &mt_rand); // Opens each bond with probability p.
+	void open(int bond); // Opens bond number "bond".
+	bool horizontal_open(int x, int y); // True if the bond (x,y)-(x,y+1) is open.
+	bool vertical_open(int x, int y); // True if the bond (x,y)-(x+1,y) is open.
+	bool isolated(int x, int y); // True if none of the 4 bonds around (x,y) are open.
+};
+
+int label_bond_lattice(BondLattice &B, int L[MAX_SIZE][MAX_SIZE], int* cluster_labels); // Labels every site touching an open bond & joins the clusters along open bonds. Isolated sites are left at 0. Returns the number of labels used.
+
+double bond_F_calculation(int size, double p, std::mt19937 &mt_rand); // Same as F_calculation, but each bond is open with probability p. Returns -1 if nothing spans.
+
+void ensemble_bond_F(double* data, int size, double p, int nens, std::mt19937 &mt_rand); // Stores nens values of F for bond percolation into data.
+
+double generate_bond_lattice(int size, std::mt19937 &mt_rand); // Opens bonds in a random order until a spanning cluster appears, and returns the fraction of open bonds.
+
+void ensemble_bond_lattice(double* data, int size, int nens, std::mt19937 &mt_rand); // Does nens runs of generate_bond_lattice, and stores their pcs into data.
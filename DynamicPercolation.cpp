@@ -0,0 +1,317 @@
+#include "DynamicPercolation.h"
+#include "Instrumentation.h"
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+
+DynamicPercolation::DynamicPercolation(int size) : size(size), n_spanning(0), stamp_base(0) {
+	/*Every site starts unoccupied, and every cluster ID starts unused.*/
+
+	site_cluster = new int[size*size];
+	visited = new long long[size*size];
+	for (int i = 0; i < size*size; i++) {
+		site_cluster[i] = 0;
+		visited[i] = -1;
+	}
+
+	cluster_sites = new int[size*size + 1];
+	edge_sites = new int[size*size + 1][4];
+	for (int id = 0; id <= size*size; id++) {
+		cluster_sites[id] = 0;
+		for (int e = 0; e < 4; e++) edge_sites[id][e] = 0;
+	}
+
+	// Pushed in reverse, so the smallest IDs are handed out first.
+	for (int id = size*size; id >= 1; id--) free_ids.push_back(id);
+}
+
+DynamicPercolation::~DynamicPercolation() {
+	delete[] site_cluster;
+	delete[] visited;
+	delete[] cluster_sites;
+	delete[] edge_sites;
+}
+
+int DynamicPercolation::get_size() {
+	return size;
+}
+
+int DynamicPercolation::new_id() {
+	int id = free_ids.back();
+	free_ids.pop_back();
+	return id;
+}
+
+bool DynamicPercolation::spanning(int id) {
+	return edge_sites[id][0] > 0 && edge_sites[id][1] > 0 && edge_sites[id][2] > 0 && edge_sites[id][3] > 0;
+}
+
+void DynamicPercolation::add_to_cluster(int id, int site, int sign) {
+	/* The edges are in the same order as the *_EDGE flags: top, bottom, left, right. */
+	int x = site / size, y = site % size;
+	cluster_sites[id] += sign;
+	if (x == 0) edge_sites[id][0] += sign;
+	if (x == size - 1) edge_sites[id][1] += sign;
+	if (y == 0) edge_sites[id][2] += sign;
+	if (y == size - 1) edge_sites[id][3] += sign;
+}
+
+int DynamicPercolation::neighbours(int site, int out[N_NEIGHBOURS]) {
+	/* Same order as everywhere else: left, right, bottom, top in terms of x & y. */
+	int x = site / size, y = site % size;
+	int n = 0;
+	if (x != 0 && site_cluster[site - size] != 0) out[n++] = site - size;
+	if (x != size - 1 && site_cluster[site + size] != 0) out[n++] = site + size;
+	if (y != 0 && site_cluster[site - 1] != 0) out[n++] = site - 1;
+	if (y != size - 1 && site_cluster[site + 1] != 0) out[n++] = site + 1;
+	return n;
+}
+
+void DynamicPercolation::relabel(int from_site, int old_id, int new_id) {
+	/* Breadth-first search over the sites with old_id, starting at from_site, giving each new_id. The sizes are moved over by the caller. */
+
+	int nb[N_NEIGHBOURS];
+	queue.clear();
+	queue.push_back(from_site);
+	site_cluster[from_site] = new_id;
+
+	for (size_t head = 0; head < queue.size(); head++) {
+		int n = neighbours(queue[head], nb);
+		for (int k = 0; k < n; k++) {
+			if (site_cluster[nb[k]] == old_id) {
+				site_cluster[nb[k]] = new_id;
+				queue.push_back(nb[k]);
+			}
+		}
+	}
+}
+
+
+
+bool DynamicPercolation::occupy(int x, int y) {
+	/* Join every cluster around (x,y) into the largest of them, then add (x,y) to it. */
+
+	int site = x*size + y;
+	if (site_cluster[site] != 0) return false;
+
+	int nb[N_NEIGHBOURS];
+	int n = neighbours(site, nb);
+
+	// Pick the largest neighbouring cluster to keep.
+	int id = 0;
+	for (int k = 0; k < n; k++) {
+		if (id == 0 || cluster_sites[site_cluster[nb[k]]] > cluster_sites[id]) id = site_cluster[nb[k]];
+	}
+
+	bool was_spanning = false;
+	if (id == 0) id = new_id(); // It's a new cluster
+	else was_spanning = spanning(id);
+
+	// Move the other clusters over. The IDs are re-read, as relabelling can change them.
+	int other;
+	for (int k = 0; k < n; k++) {
+		other = site_cluster[nb[k]];
+		if (other == id) continue;
+
+		if (spanning(other)) n_spanning--;
+		relabel(nb[k], other, id);
+		cluster_sites[id] += cluster_sites[other];
+		cluster_sites[other] = 0;
+		for (int e = 0; e < 4; e++) {
+			edge_sites[id][e] += edge_sites[other][e];
+			edge_sites[other][e] = 0;
+		}
+		free_ids.push_back(other);
+		INSTRUMENT_COUNT(UNIONS, 1);
+	}
+
+	site_cluster[site] = id;
+	add_to_cluster(id, site, 1);
+	n_spanning += (int)spanning(id) - (int)was_spanning;
+
+	return true;
+}
+
+
+
+bool DynamicPercolation::vacate(int x, int y) {
+	/* Remove (x,y), then find out whether its cluster has split, with a search from each of its occupied neighbours. */
+
+	int site = x*size + y;
+	int id = site_cluster[site];
+	if (id == 0) return false;
+
+	bool was_spanning = spanning(id);
+	add_to_cluster(id, site, -1);
+	site_cluster[site] = 0;
+
+	int nb[N_NEIGHBOURS];
+	int n = neighbours(site, nb);
+
+	if (cluster_sites[id] == 0) { // That was the whole cluster.
+		free_ids.push_back(id);
+		if (was_spanning) n_spanning--;
+		return true;
+	}
+
+	if (n <= 1) { // A cluster can't split at a site with only 1 neighbour in it.
+		n_spanning += (int)spanning(id) - (int)was_spanning;
+		return true;
+	}
+
+	// One search per neighbour. found[s] is everything search s has reached, and also its queue, from head[s] on.
+	// group[s] joins searches that have met, as they're exploring the same piece.
+	stamp_base += N_NEIGHBOURS;
+	size_t head[N_NEIGHBOURS];
+	int group[N_NEIGHBOURS];
+	for (int s = 0; s < n; s++) {
+		found[s].clear();
+		found[s].push_back(nb[s]);
+		head[s] = 0;
+		group[s] = s;
+		visited[nb[s]] = stamp_base + s;
+	}
+
+	int nb2[N_NEIGHBOURS];
+	int n2, t, a, b;
+	int n_unfinished; // Pieces that still have sites to explore.
+	bool unfinished[N_NEIGHBOURS];
+	int root_of_group;
+
+	while (true) {
+
+		// A group is finished once every search in it has run out of sites.
+		for (int s = 0; s < n; s++) unfinished[s] = false;
+		for (int s = 0; s < n; s++) {
+			root_of_group = s;
+			while (group[root_of_group] != root_of_group) root_of_group = group[root_of_group];
+			if (head[s] < found[s].size()) unfinished[root_of_group] = true;
+		}
+		n_unfinished = 0;
+		for (int s = 0; s < n; s++) if (group[s] == s && unfinished[s]) n_unfinished++;
+
+		if (n_unfinished <= 1) break; // Every other piece is known now.
+
+		// Each search takes 1 step.
+		for (int s = 0; s < n; s++) {
+			if (head[s] == found[s].size()) continue;
+
+			n2 = neighbours(found[s][head[s]], nb2);
+			head[s]++;
+			for (int k = 0; k < n2; k++) {
+				if (visited[nb2[k]] >= stamp_base) { // Reached by a search already - if it's another one, they're in the same piece.
+					t = (int)(visited[nb2[k]] - stamp_base);
+					a = s;
+					b = t;
+					while (group[a] != a) a = group[a];
+					while (group[b] != b) b = group[b];
+					if (a != b) group[b < a ? a : b] = b < a ? b : a;
+				}
+				else {
+					visited[nb2[k]] = stamp_base + s;
+					found[s].push_back(nb2[k]);
+				}
+			}
+		}
+	}
+
+	// The piece that keeps the old ID is the one still being explored, or the largest if they've all finished.
+	int root[N_NEIGHBOURS];
+	int piece_sites[N_NEIGHBOURS] = { 0 };
+	for (int s = 0; s < n; s++) {
+		root[s] = s;
+		while (group[root[s]] != root[s]) root[s] = group[root[s]];
+		piece_sites[root[s]] += (int)found[s].size();
+	}
+
+	int kept = -1;
+	for (int s = 0; s < n; s++) {
+		if (group[s] != s) continue;
+		if (unfinished[s]) {
+			kept = s;
+			break;
+		}
+		if (kept == -1 || piece_sites[s] > piece_sites[kept]) kept = s;
+	}
+
+	// Every other piece gets a new ID.
+	int new_ids[N_NEIGHBOURS];
+	for (int s = 0; s < n; s++) new_ids[s] = (group[s] == s && s != kept) ? new_id() : 0;
+
+	for (int s = 0; s < n; s++) {
+		if (root[s] == kept) continue;
+		int piece = new_ids[root[s]];
+		for (size_t i = 0; i < found[s].size(); i++) {
+			site_cluster[found[s][i]] = piece;
+			add_to_cluster(piece, found[s][i], 1);
+			add_to_cluster(id, found[s][i], -1);
+		}
+	}
+
+	n_spanning += (int)spanning(id) - (int)was_spanning;
+	for (int s = 0; s < n; s++) {
+		if (new_ids[s] != 0 && spanning(new_ids[s])) n_spanning++;
+	}
+
+	return true;
+}
+
+bool DynamicPercolation::occupied(int x, int y) {
+	return site_cluster[x*size + y] != 0;
+}
+
+bool DynamicPercolation::connected(int ax, int ay, int bx, int by) {
+	int a = site_cluster[ax*size + ay];
+	return a != 0 && a == site_cluster[bx*size + by];
+}
+
+bool DynamicPercolation::spans() {
+	return n_spanning > 0;
+}
+
+int DynamicPercolation::cluster_size(int x, int y) {
+	int id = site_cluster[x*size + y];
+	if (id == 0) return 0;
+	return cluster_sites[id];
+}
+
+int DynamicPercolation::cluster_id(int x, int y) {
+	return site_cluster[x*size + y];
+}
+
+
+
+double removal_threshold(int size, double p, mt19937 &mt_rand) {
+	/* A failure cascade: start from a lattice of occupation probability p, and remove random occupied sites until there's no spanning cluster.
+		Each removal only costs a local search, rather than labelling the lattice again. */
+
+	DynamicPercolation D(size);
+	vector<int> occupied_sites;
+
+	for (int i = 0; i < size; i++) {
+		for (int j = 0; j < size; j++) {
+			if (randreal(mt_rand, p)) {
+				D.occupy(i, j);
+				occupied_sites.push_back(i*size + j);
+			}
+		}
+	}
+
+	if (!D.spans()) return -1; // Nothing to break.
+
+	int k, site;
+	while (D.spans()) {
+		// Take a random occupied site out of the list, by swapping it to the end.
+		k = random(mt_rand, (int)occupied_sites.size());
+		site = occupied_sites[k];
+		occupied_sites[k] = occupied_sites.back();
+		occupied_sites.pop_back();
+
+		D.vacate(site / size, site % size);
+	}
+
+	return (double)occupied_sites.size() / (size*size);
+}
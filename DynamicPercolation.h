@@ -0,0 +1,52 @@
+#pragma once
+#include "Lattice.h"
+#include <random>
+#include <vector>
+
+// A lattice where sites can be occupied & vacated one at a time, keeping track of the clusters as it goes.
+// Each occupied site holds the ID of its cluster, and each cluster ID keeps its size & how many of its sites are on each edge.
+// Occupying a site that bridges clusters relabels the smaller ones into the largest, so each site is relabelled O(log N) times at most.
+// Vacating a site can only split its cluster if 2 or more of its neighbours are occupied. Then a search is started from each of them,
+// taking turns 1 site at a time. Searches that meet are part of the same piece. As soon as every piece but 1 has been explored
+// completely, the searching stops - the last piece keeps the old ID, and only the smaller pieces are relabelled.
+// So a vacate costs O(size of the smaller pieces), rather than relabelling the whole lattice.
+
+class DynamicPercolation
+{
+private:
+
+	int size; // Length of each side of the lattice.
+	int* site_cluster; // Cluster ID of each site, x*size+y, or 0 if it's unoccupied.
+
+	// Per cluster ID. IDs go from 1 to size*size; unused IDs are kept in free_ids.
+	int* cluster_sites; // Number of sites in the cluster.
+	int (*edge_sites)[4]; // Number of its sites on the top, bottom, left & right edges.
+	std::vector<int> free_ids;
+	int n_spanning; // Number of clusters with sites on all 4 edges.
+
+	// Scratch for the searches, reused by every call.
+	long long* visited; // Search stamp of each site. Stamps >= stamp_base belong to the current vacate.
+	long long stamp_base;
+	std::vector<int> queue;
+	std::vector<int> found[N_NEIGHBOURS]; // Sites reached by each search in vacate.
+
+	int new_id(); // Takes an unused cluster ID.
+	bool spanning(int id); // True if the cluster has sites on all 4 edges.
+	void add_to_cluster(int id, int site, int sign); // Adds (sign = 1) or removes (sign = -1) a site from a cluster's size & edge counts.
+	void relabel(int from_site, int old_id, int new_id); // Moves every site connected to from_site with ID old_id over to new_id.
+	int neighbours(int site, int out[N_NEIGHBOURS]); // Saves the occupied neighbours of site into out, and returns how many.
+public:
+	DynamicPercolation(int size); // An empty lattice.
+	~DynamicPercolation();
+	int get_size(); // Length of each side of the lattice.
+
+	bool occupy(int x, int y); // Occupies (x,y). Returns false if it was already occupied.
+	bool vacate(int x, int y); // Vacates (x,y). Returns false if it was already unoccupied.
+	bool occupied(int x, int y); // True if (x,y) is occupied.
+	bool connected(int ax, int ay, int bx, int by); // True if both sites are occupied & in the same cluster.
+	bool spans(); // True if some cluster has sites on all 4 edges.
+	int cluster_size(int x, int y); // Number of sites in the cluster of (x,y), or 0 if it's unoccupied.
+	int cluster_id(int x, int y); // ID of the cluster of (x,y), or 0 if it's unoccupied. IDs are reused, so only compare them between updates.
+};
+
+double removal_threshold(int size, double p, std::mt19937 &mt_rand); // Occupies each site with probability p, then vacates random occupied sites until nothing spans. Returns the fraction of sites still occupied then, or -1 if it never spanned.
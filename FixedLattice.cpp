@@ -0,0 +1,70 @@
+#include "FixedLattice.h"
+#include "Instrumentation.h"
+#include <random>
+
+using namespace std;
+
+
+template<int L>
+void run_ensemble_F(double* data, double p, int nens, mt19937 &mt_rand) {
+	/* Same as ensemble_F, with 1 lattice for the whole ensemble. It's allocated, as the larger sizes are too big for some stacks. */
+
+	FixedLattice<L>* lattice = new FixedLattice<L>;
+	int i = 0;
+	double val;
+
+	while (i < nens) {
+		val = lattice->F_calculation(p, mt_rand);
+		if (val > 0) {
+			data[i] = val;
+			i++;
+		}
+		else INSTRUMENT_COUNT(REJECTED_LATTICES, 1);
+		INSTRUMENT_POLL();
+	}
+
+	delete lattice;
+}
+
+template<int L>
+void run_ensemble_lattice(double* data, int nens, mt19937 &mt_rand) {
+	/* Same as ensemble_lattice, with 1 lattice for the whole ensemble. */
+
+	FixedLattice<L>* lattice = new FixedLattice<L>;
+
+	for (int i = 0; i < nens; i++) {
+		data[i] = lattice->generate_lattice(mt_rand);
+		INSTRUMENT_POLL();
+	}
+
+	delete lattice;
+}
+
+
+
+bool fixed_size(int size) {
+	switch (size) {
+#define FIXED_CASE(L) case L: return true;
+		PERCOLATION_FIXED_SIZES(FIXED_CASE)
+#undef FIXED_CASE
+	default: return false;
+	}
+}
+
+bool fixed_ensemble_F(double* data, int size, double p, int nens, mt19937 &mt_rand) {
+	switch (size) {
+#define FIXED_CASE(L) case L: run_ensemble_F<L>(data, p, nens, mt_rand); return true;
+		PERCOLATION_FIXED_SIZES(FIXED_CASE)
+#undef FIXED_CASE
+	default: return false;
+	}
+}
+
+bool fixed_ensemble_lattice(double* data, int size, int nens, mt19937 &mt_rand) {
+	switch (size) {
+#define FIXED_CASE(L) case L: run_ensemble_lattice<L>(data, nens, mt_rand); return true;
+		PERCOLATION_FIXED_SIZES(FIXED_CASE)
+#undef FIXED_CASE
+	default: return false;
+	}
+}
@@ -0,0 +1,209 @@
+#pragma once
+#include "Lattice.h"
+#include "Instrumentation.h"
+#include <random>
+#include <cstring>
+#include <iostream>
+
+// Kernels for lattices whose size is known at compile time, for the sizes used by the finite-size studies.
+// The lattice is padded with a border of unoccupied sites, so the 4 neighbours of a site are always at fixed offsets, with no edge checks.
+// Bounds, offsets & the edge mask of every site are constants, so the compiler can unroll the row loops, and a whole realization
+// (sites, labels & edges) fits in L1 for every size in the list.
+// Same random numbers, same results as the Workspace versions of F_calculation & generate_lattice.
+//
+// The sizes are set with PERCOLATION_FIXED_SIZES, which can be replaced on the command line. Every other size uses the generic kernels.
+
+#ifndef PERCOLATION_FIXED_SIZES
+#define PERCOLATION_FIXED_SIZES(X) X(5) X(10) X(15) X(20) X(25) X(50)
+#endif
+
+template<int L>
+struct FixedEdgeTable {
+	unsigned char mask[(L + 2)*(L + 2)]; // The edge mask of every padded site. The padding itself has no edges.
+
+	constexpr FixedEdgeTable() : mask() {
+		/* Filled in a constexpr constructor rather than through std::array, whose operator[] is only constexpr from C++17. */
+		for (int x = 0; x < L; x++) {
+			for (int y = 0; y < L; y++) {
+				mask[(x + 1)*(L + 2) + y + 1] = (unsigned char)((x == 0 ? TOP_EDGE : 0) | (x == L - 1 ? BOTTOM_EDGE : 0) | (y == 0 ? LEFT_EDGE : 0) | (y == L - 1 ? RIGHT_EDGE : 0));
+			}
+		}
+	}
+};
+
+template<int L>
+class FixedLattice
+{
+private:
+
+	static constexpr int P = L + 2; // Length of a padded row.
+	static constexpr int N = P*P; // Sites including the padding.
+	static constexpr FixedEdgeTable<L> edge_table = FixedEdgeTable<L>();
+
+	int sites[N]; // Assigned label of each site, (x+1)*P + (y+1), or 0 if unoccupied. The padding is always 0.
+	int cluster_labels[L*L + 1]; // Same convention as everywhere else: a negative entry references another label, and a proper label holds the size of its cluster.
+	unsigned char edges[L*L + 1]; // Edges touched by each cluster, while its label is proper.
+	int n_labels; // Next label to hand out.
+
+	static constexpr int index(int x, int y) { return (x + 1)*P + y + 1; }
+
+	void reset() {
+		std::memset(sites, 0, sizeof(sites));
+		cluster_labels[0] = 0;
+		edges[0] = 0;
+		n_labels = 1;
+	}
+
+	int new_label(int i) {
+		int c = n_labels;
+		n_labels++;
+		cluster_labels[c] = 1;
+		edges[c] = edge_table.mask[i];
+		return c;
+	}
+
+	int find(int c) {
+		/* Same as Workspace::find: walk to the proper label, then point the whole path straight at it. */
+		int root = c;
+		int steps = 0;
+		while (cluster_labels[root] < 0) {
+			root = -cluster_labels[root];
+			steps++;
+		}
+		int next;
+		while (c != root) {
+			next = -cluster_labels[c];
+			cluster_labels[c] = -root;
+			c = next;
+		}
+		INSTRUMENT_COUNT(FIND_PROPER_LABEL_CALLS, 1);
+		INSTRUMENT_COUNT(FIND_PROPER_LABEL_STEPS, steps);
+		return root;
+	}
+
+	int merge(int a, int b) {
+		/* Joins the clusters under the smaller proper label, and returns it. */
+		a = find(a);
+		b = find(b);
+		if (a == b) return a;
+		if (b < a) std::swap(a, b);
+		cluster_labels[a] += cluster_labels[b];
+		edges[a] |= edges[b];
+		cluster_labels[b] = -a;
+		INSTRUMENT_COUNT(UNIONS, 1);
+		return a;
+	}
+
+public:
+	FixedLattice() { reset(); }
+
+	int get_size() { return L; }
+
+	int get_site(int x, int y) { return sites[index(x, y)]; } // Assigned label of (x,y), or 0 if it's unoccupied.
+
+	int find_spanning_cluster() {
+		/* Every spanning cluster touches the top edge, so only the clusters on the top edge are checked. */
+		INSTRUMENT_COUNT(SPANNING_CHECKS, 1);
+		INSTRUMENT_COUNT(EDGE_SITES_SCANNED, L);
+		int label;
+		for (int i = index(0, 0); i < index(0, L); i++) {
+			if (sites[i] == 0) continue;
+			label = find(sites[i]);
+			if (edges[label] == ALL_EDGES) return label;
+		}
+		return 0;
+	}
+
+	double F_calculation(const double p, std::mt19937 &mt_rand) {
+		/* Same as F_calculation(Workspace&): the sites are filled in the same order, then each occupied site is linked to its occupied neighbours to the left & above.
+			The distribution is made once instead of once per site, which doesn't change the numbers drawn. */
+
+		if (p < 0 || p > 1) {
+			std::cout << "ERROR: p must be a double in the range [0,1]" << std::endl;
+			return -1;
+		}
+
+		reset();
+		std::uniform_real_distribution<double> unit(0, 1);
+
+		INSTRUMENT_PHASE_BEGIN(PHASE_GENERATE);
+		for (int x = 0; x < L; x++) {
+			for (int i = index(x, 0); i < index(x, L); i++) {
+				if (unit(mt_rand) <= p) sites[i] = new_label(i);
+			}
+		}
+		INSTRUMENT_PHASE_END(PHASE_GENERATE);
+
+		// The padding is unoccupied, so the first row & column need no checks.
+		INSTRUMENT_PHASE_BEGIN(PHASE_LABEL);
+		for (int x = 0; x < L; x++) {
+			for (int i = index(x, 0); i < index(x, L); i++) {
+				if (sites[i] == 0) continue;
+				if (sites[i - 1] != 0) merge(sites[i - 1], sites[i]);
+				if (sites[i - P] != 0) merge(sites[i - P], sites[i]);
+			}
+		}
+		INSTRUMENT_PHASE_END(PHASE_LABEL);
+
+		// F = spanning cluster size / occupied sites, and every occupied site has its own label.
+		INSTRUMENT_PHASE_BEGIN(PHASE_MEASURE);
+		int spanning_cluster = find_spanning_cluster();
+		INSTRUMENT_PHASE_END(PHASE_MEASURE);
+		if (spanning_cluster == 0) return -1;
+		return (double)cluster_labels[spanning_cluster] / (n_labels - 1);
+	}
+
+	double generate_lattice(std::mt19937 &mt_rand) {
+		/* Same as generate_lattice(Workspace&): random sites are occupied until a spanning cluster appears, and pc is returned.
+			The 4 neighbours are always there, padding or not, so they're read without any checks. */
+
+		reset();
+		std::uniform_int_distribution<int> coordinate(0, L - 1);
+
+		int i, x, y, label, other;
+		const int offsets[N_NEIGHBOURS] = { -P, P, -1, 1 };
+		int n_occupied = 0;
+
+		INSTRUMENT_PHASE_BEGIN(PHASE_GENERATE);
+		while (true) {
+
+			do {
+				x = coordinate(mt_rand);
+				y = coordinate(mt_rand);
+				i = index(x, y);
+			} while (sites[i] != 0);
+			n_occupied++;
+
+			// Join the cluster with the smallest proper label around it, then merge the rest into that one.
+			label = 0;
+			for (int k = 0; k < N_NEIGHBOURS; k++) {
+				if (sites[i + offsets[k]] == 0) continue;
+				other = find(sites[i + offsets[k]]);
+				label = label == 0 ? other : merge(label, other);
+			}
+
+			if (label == 0) { // It's a new cluster
+				sites[i] = new_label(i);
+				continue; // A single site can't touch all 4 edges.
+			}
+
+			sites[i] = label;
+			cluster_labels[label]++;
+			edges[label] |= edge_table.mask[i];
+
+			if (edges[label] == ALL_EDGES) break; // Spanning cluster found.
+		}
+		INSTRUMENT_PHASE_END(PHASE_GENERATE);
+
+		return (double)n_occupied / (L*L);
+	}
+};
+
+template<int L>
+constexpr FixedEdgeTable<L> FixedLattice<L>::edge_table; // Definition, which C++14 needs for the table to be indexed at run time.
+
+bool fixed_size(int size); // True if there are compiled kernels for this size.
+
+bool fixed_ensemble_F(double* data, int size, double p, int nens, std::mt19937 &mt_rand); // ensemble_F with the compiled kernels. Returns false, doing nothing, if there are none for this size.
+
+bool fixed_ensemble_lattice(double* data, int size, int nens, std::mt19937 &mt_rand); // ensemble_lattice with the compiled kernels. Returns false, doing nothing, if there are none for this size.
@@ -0,0 +1,141 @@
+#include "Instrumentation.h"
+
+#ifdef PERCOLATION_INSTRUMENT
+
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include <string>
+#include <csignal>
+#include <cstdlib>
+
+using namespace std;
+
+
+const char* counter_names[N_COUNTERS] = { "find_proper_label_calls", "find_proper_label_steps", "unions", "spanning_checks", "edge_sites_scanned", "rejected_lattices", "bytes_written" };
+const char* phase_names[N_PHASES] = { "generate", "label", "measure", "write" };
+
+// Every thread's block of counters. The blocks are never freed, so that threads which have finished still show up in the dump.
+static mutex registry_mutex;
+static vector<ThreadCounters*> registry;
+
+static string dump_filename; // Where instrumentation_install asked for the dump to go.
+static volatile sig_atomic_t dump_requested = 0; // Set by the signal handler, cleared by instrumentation_poll.
+
+
+ThreadCounters* register_thread() {
+	/* Makes a zeroed block of counters for the calling thread, and adds it to the registry.
+		This is the only time the mutex is taken by a thread that's counting. */
+
+	ThreadCounters* t = new ThreadCounters;
+	for (int i = 0; i < N_COUNTERS; i++) t->counts[i] = 0;
+	for (int i = 0; i < N_PHASES; i++) {
+		t->phase_ns[i] = 0;
+		t->phase_calls[i] = 0;
+		t->phase_start[i] = 0;
+	}
+
+	lock_guard<mutex> lock(registry_mutex);
+	registry.push_back(t);
+	return t;
+}
+
+ThreadCounters& thread_counters() {
+	/* Every thread registers once, and then just uses its own pointer. */
+	thread_local ThreadCounters* mine = register_thread();
+	return *mine;
+}
+
+long long instrument_now() {
+	/* Nanoseconds since some fixed point, on a clock that never goes backwards. */
+	return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+
+bool instrumentation_to_json(const char* filename) {
+	/* Add up the counters of every thread, then write the totals, and the number of threads, to filename. */
+
+	long long counts[N_COUNTERS] = { 0 };
+	long long phase_ns[N_PHASES] = { 0 };
+	long long phase_calls[N_PHASES] = { 0 };
+	int n_threads;
+
+	{
+		lock_guard<mutex> lock(registry_mutex);
+		n_threads = (int)registry.size();
+		for (ThreadCounters* t : registry) {
+			for (int i = 0; i < N_COUNTERS; i++) counts[i] += t->counts[i].load(memory_order_relaxed);
+			for (int i = 0; i < N_PHASES; i++) {
+				phase_ns[i] += t->phase_ns[i].load(memory_order_relaxed);
+				phase_calls[i] += t->phase_calls[i].load(memory_order_relaxed);
+			}
+		}
+	}
+
+	ofstream outfile(filename, ios::out);
+
+	if (!outfile) {
+		cout << "Failed to create file" << endl;
+		return EXIT_FAILURE;
+	}
+
+	outfile << "{" << endl;
+	outfile << "  \"threads\": " << n_threads << "," << endl;
+	outfile << "  \"counters\": {" << endl;
+	for (int i = 0; i < N_COUNTERS; i++) {
+		outfile << "    \"" << counter_names[i] << "\": " << counts[i];
+		if (i < N_COUNTERS - 1) outfile << ",";
+		outfile << endl;
+	}
+	outfile << "  }," << endl;
+	outfile << "  \"phases\": {" << endl;
+	for (int i = 0; i < N_PHASES; i++) {
+		outfile << "    \"" << phase_names[i] << "\": {\"seconds\": " << phase_ns[i] * 1e-9 << ", \"calls\": " << phase_calls[i] << "}";
+		if (i < N_PHASES - 1) outfile << ",";
+		outfile << endl;
+	}
+	outfile << "  }" << endl;
+	outfile << "}" << endl;
+
+	outfile.close();
+
+	return EXIT_SUCCESS;
+}
+
+
+
+void dump_at_exit() {
+	instrumentation_to_json(dump_filename.c_str());
+}
+
+void request_dump(int signal_number) {
+	/* Only set a flag - the dump is done by instrumentation_poll, outside of the handler. */
+	dump_requested = 1;
+	std::signal(signal_number, request_dump); // Some platforms reset the handler after each signal.
+}
+
+void instrumentation_install(const char* filename) {
+	/* Remember where to dump, and ask to be told at exit & on the dump signal. */
+
+	dump_filename = filename;
+	atexit(dump_at_exit);
+
+#if defined(SIGUSR1)
+	std::signal(SIGUSR1, request_dump);
+#elif defined(SIGBREAK)
+	std::signal(SIGBREAK, request_dump);
+#endif
+}
+
+void instrumentation_poll() {
+	/* Cheap enough to call once per realization: it only reads a flag, unless a signal has come in. */
+
+	if (!dump_requested) return;
+	dump_requested = 0;
+	instrumentation_to_json(dump_filename.c_str());
+}
+
+#endif
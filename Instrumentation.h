@@ -0,0 +1,81 @@
+#pragma once
+
+// Optional counters & phase timers for the hot paths.
+// Compile with -DPERCOLATION_INSTRUMENT, and add Instrumentation.cpp, to turn them on. Without it every macro below expands to nothing,
+// so the kernels compile exactly as they would without any instrumentation.
+//
+// Each thread gets its own block of counters the first time it counts something, so threads never write to the same memory.
+// The blocks are only added together when they're dumped as JSON, either at exit or when the program gets SIGUSR1 (SIGBREAK on Windows).
+// A signal only sets a flag - the dump itself happens at the next INSTRUMENT_POLL(), as it isn't safe to write files inside a signal handler.
+
+#ifdef PERCOLATION_INSTRUMENT
+
+#include <atomic>
+
+enum Counter {
+	FIND_PROPER_LABEL_CALLS, // Calls to find_proper_label
+	FIND_PROPER_LABEL_STEPS, // References followed by find_proper_label, ie. the total path length walked
+	UNIONS, // Clusters linked by rewrite_labels
+	SPANNING_CHECKS, // Calls to find_spanning_cluster
+	EDGE_SITES_SCANNED, // Edge sites read by find_spanning_cluster
+	REJECTED_LATTICES, // Lattices thrown away by ensemble_F & ensemble_bond_F for having no spanning cluster
+	BYTES_WRITTEN, // Bytes written to output files
+	N_COUNTERS
+};
+
+enum Phase {
+	PHASE_GENERATE, // Occupying sites or bonds
+	PHASE_LABEL, // Linking occupied sites into clusters
+	PHASE_MEASURE, // Spanning check & observables
+	PHASE_WRITE, // Writing output files
+	N_PHASES
+};
+
+struct ThreadCounters {
+	// Only the owning thread writes to these, so relaxed loads & stores are enough, and the dump can read them at any time.
+	std::atomic<long long> counts[N_COUNTERS];
+	std::atomic<long long> phase_ns[N_PHASES]; // Total time spent in each phase
+	std::atomic<long long> phase_calls[N_PHASES]; // Number of times each phase was entered
+	long long phase_start[N_PHASES]; // When the current phase was entered. Private to the thread.
+};
+
+ThreadCounters& thread_counters(); // Gets the counters of the calling thread, registering them on first use.
+
+long long instrument_now(); // Nanoseconds on the steady clock.
+
+inline void instrument_count(Counter which, long long n) {
+	std::atomic<long long>& c = thread_counters().counts[which];
+	c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+inline void instrument_phase_begin(Phase phase) {
+	thread_counters().phase_start[phase] = instrument_now();
+}
+
+inline void instrument_phase_end(Phase phase) {
+	ThreadCounters& t = thread_counters();
+	t.phase_ns[phase].store(t.phase_ns[phase].load(std::memory_order_relaxed) + instrument_now() - t.phase_start[phase], std::memory_order_relaxed);
+	t.phase_calls[phase].store(t.phase_calls[phase].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+bool instrumentation_to_json(const char* filename); // Adds up the counters of every thread, and writes them to filename as JSON.
+
+void instrumentation_install(const char* filename); // Dumps to filename at exit, and on SIGUSR1/SIGBREAK at the next INSTRUMENT_POLL().
+
+void instrumentation_poll(); // Does the dump if a signal asked for one.
+
+#define INSTRUMENT_COUNT(counter, n) instrument_count(counter, n)
+#define INSTRUMENT_PHASE_BEGIN(phase) instrument_phase_begin(phase)
+#define INSTRUMENT_PHASE_END(phase) instrument_phase_end(phase)
+#define INSTRUMENT_INSTALL(filename) instrumentation_install(filename)
+#define INSTRUMENT_POLL() instrumentation_poll()
+
+#else
+
+#define INSTRUMENT_COUNT(counter, n) ((void)0)
+#define INSTRUMENT_PHASE_BEGIN(phase) ((void)0)
+#define INSTRUMENT_PHASE_END(phase) ((void)0)
+#define INSTRUMENT_INSTALL(filename) ((void)0)
+#define INSTRUMENT_POLL() ((void)0)
+
+#endif
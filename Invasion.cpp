@@ -0,0 +1,234 @@
+#include "Invasion.h"
+#include "Instrumentation.h"
+#include <iostream>
+#include <cstring>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+using namespace std;
+
+
+// States of a site.
+const unsigned char UNTOUCHED = 0; // No strength yet.
+const unsigned char PERIMETER = 1; // Waiting in the queue.
+const unsigned char INVADED = 2;
+const unsigned char TRAPPED = 3;
+const unsigned char RETURNED = 4; // Given back to the uninvaded sites while looking for trapped ones, and not trapped.
+const unsigned char RETURNED_TRAPPED = 5; // Same, and trapped.
+
+static int lowest_bit(unsigned long long word) {
+	/* Position of the lowest set bit of a nonzero word. */
+
+#ifdef _MSC_VER
+	unsigned long i;
+	_BitScanForward64(&i, word);
+	return (int)i;
+#else
+	return __builtin_ctzll(word);
+#endif
+}
+
+
+
+BucketQueue::BucketQueue() : level2(0) {
+	buckets = new vector<int>[N_STRENGTHS];
+	memset(level0, 0, sizeof(level0));
+	memset(level1, 0, sizeof(level1));
+}
+
+BucketQueue::~BucketQueue() {
+	delete[] buckets;
+}
+
+void BucketQueue::push(int strength, int site) {
+	buckets[strength].push_back(site);
+	level0[strength >> 6] |= 1ULL << (strength & 63);
+	level1[strength >> 12] |= 1ULL << ((strength >> 6) & 63);
+	level2 |= 1ULL << (strength >> 12);
+}
+
+int BucketQueue::pop(int &strength) {
+	/* Follow the lowest set bit down the 3 levels to the lowest non-empty bucket, then clear the bits of anything that's now empty. */
+
+	if (level2 == 0) return -1;
+	int i2 = lowest_bit(level2);
+	int i1 = (i2 << 6) | lowest_bit(level1[i2]);
+	strength = (i1 << 6) | lowest_bit(level0[i1]);
+
+	int site = buckets[strength].back();
+	buckets[strength].pop_back();
+	if (buckets[strength].empty()) {
+		level0[i1] &= ~(1ULL << (strength & 63));
+		if (level0[i1] == 0) {
+			level1[i2] &= ~(1ULL << (i1 & 63));
+			if (level1[i2] == 0) level2 &= ~(1ULL << i2);
+		}
+	}
+	return site;
+}
+
+void BucketQueue::clear() {
+	/* Only the buckets marked in level0 can hold anything. */
+
+	for (int i = 0; i < N_STRENGTHS / 64; i++) {
+		unsigned long long word = level0[i];
+		while (word != 0) {
+			buckets[(i << 6) | lowest_bit(word)].clear();
+			word &= word - 1;
+		}
+		level0[i] = 0;
+	}
+	memset(level1, 0, sizeof(level1));
+	level2 = 0;
+}
+
+
+
+InvasionLattice::InvasionLattice(int size) : size(size), regions(NULL) {
+	state = new unsigned char[size*size];
+}
+
+InvasionLattice::~InvasionLattice() {
+	delete[] state;
+	delete[] regions;
+}
+
+int InvasionLattice::get_size() {
+	return size;
+}
+
+bool InvasionLattice::invaded(int x, int y) {
+	return state[x*size + y] == INVADED;
+}
+
+void InvasionLattice::add_perimeter(int site, mt19937 &mt_rand) {
+	state[site] = PERIMETER;
+	perimeter.push((int)(mt_rand() >> (32 - STRENGTH_BITS)), site);
+}
+
+InvasionResult InvasionLattice::invade(mt19937 &mt_rand, bool trapping) {
+	/* The whole top row starts on the perimeter. Each invaded site puts its untouched neighbours on the perimeter. */
+
+	InvasionResult result = { 0, 0, 0, 0 };
+	int n_sites = size*size;
+	int site, strength, x, y;
+	int max_strength = 0;
+
+	INSTRUMENT_PHASE_BEGIN(PHASE_GENERATE);
+	memset(state, UNTOUCHED, n_sites);
+	perimeter.clear();
+	order.clear();
+	for (y = 0; y < size; y++) add_perimeter(y, mt_rand);
+
+	while ((site = perimeter.pop(strength)) >= 0) {
+		state[site] = INVADED;
+		order.push_back(site);
+		if (strength > max_strength) max_strength = strength;
+
+		x = site / size;
+		y = site % size;
+		if (x == size - 1) break; // Breakthrough
+
+		if (x != 0 && state[site - size] == UNTOUCHED) add_perimeter(site - size, mt_rand);
+		if (state[site + size] == UNTOUCHED) add_perimeter(site + size, mt_rand);
+		if (y != 0 && state[site - 1] == UNTOUCHED) add_perimeter(site - 1, mt_rand);
+		if (y != size - 1 && state[site + 1] == UNTOUCHED) add_perimeter(site + 1, mt_rand);
+	}
+	INSTRUMENT_PHASE_END(PHASE_GENERATE);
+
+	if (trapping) {
+		INSTRUMENT_PHASE_BEGIN(PHASE_LABEL);
+		result.trapped = trap();
+		INSTRUMENT_PHASE_END(PHASE_LABEL);
+	}
+
+	result.invaded = (int)order.size() - result.trapped;
+	result.fraction = (double)result.invaded / n_sites;
+	result.threshold = (double)(max_strength + 1) / N_STRENGTHS;
+	return result;
+}
+
+int InvasionLattice::find_region(int site) {
+	while (regions[site] != site) {
+		regions[site] = regions[regions[site]];
+		site = regions[site];
+	}
+	return site;
+}
+
+void InvasionLattice::join_regions(int a, int b) {
+	/* The smaller root is kept, as with cluster labels, so a row by row scan mostly links new sites onto roots that are already there. */
+
+	a = find_region(a);
+	b = find_region(b);
+	if (a < b) regions[b] = a;
+	else if (b < a) regions[a] = b;
+}
+
+int InvasionLattice::trap() {
+	/* Join up every uninvaded site first. Then give the invaded sites back, latest first: when a site is given back, the uninvaded sites are
+		exactly the ones that were uninvaded when it was invaded, so it was trapped if its region isn't joined to the bottom edge.
+		The breakthrough site is on the bottom edge, so it's never trapped. */
+
+	int n_sites = size*size;
+	int outlet = n_sites;
+	if (regions == NULL) regions = new int[n_sites + 1];
+	for (int i = 0; i <= n_sites; i++) regions[i] = i;
+
+	int site, x, y;
+	int neighbours[4];
+	int n_neighbours;
+	int n_trapped = 0;
+
+	// Uninvaded sites, joined to their uninvaded neighbours above & to the left, and to the outlet on the bottom row.
+	for (site = 0; site < n_sites; site++) {
+		if (state[site] == INVADED) continue;
+		x = site / size;
+		y = site % size;
+		if (y != 0 && state[site - 1] != INVADED) join_regions(site, site - 1);
+		if (x != 0 && state[site - size] != INVADED) join_regions(site, site - size);
+		if (x == size - 1) join_regions(site, outlet);
+	}
+
+	for (int k = (int)order.size() - 1; k >= 0; k--) {
+		site = order[k];
+		x = site / size;
+		y = site % size;
+
+		n_neighbours = 0;
+		if (x != 0) neighbours[n_neighbours++] = site - size;
+		if (x != size - 1) neighbours[n_neighbours++] = site + size;
+		else neighbours[n_neighbours++] = outlet;
+		if (y != 0) neighbours[n_neighbours++] = site - 1;
+		if (y != size - 1) neighbours[n_neighbours++] = site + 1;
+
+		for (int i = 0; i < n_neighbours; i++) {
+			if (neighbours[i] != outlet && state[neighbours[i]] == INVADED) continue;
+			join_regions(site, neighbours[i]);
+		}
+
+		if (find_region(site) == find_region(outlet)) state[site] = RETURNED;
+		else {
+			state[site] = RETURNED_TRAPPED;
+			n_trapped++;
+		}
+	}
+
+	for (size_t k = 0; k < order.size(); k++) state[order[k]] = state[order[k]] == RETURNED ? INVADED : TRAPPED;
+
+	return n_trapped;
+}
+
+
+
+void ensemble_invasion(double* data, int size, int nens, mt19937 &mt_rand, bool trapping) {
+	/* Same as ensemble_lattice, with the fill fraction at breakthrough of each invasion. */
+
+	InvasionLattice I(size);
+	for (int i = 0; i < nens; i++) {
+		data[i] = I.invade(mt_rand, trapping).fraction;
+		INSTRUMENT_POLL();
+	}
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <random>
+#include <vector>
+
+// Invasion percolation: every site has a random strength, and the invading cluster grows from the top edge by always invading the weakest
+// site on its perimeter, until it breaks through to the bottom edge. Unlike generate_lattice, sites are only ever added next to the cluster.
+// Strengths are only drawn when a site first joins the perimeter, which gives the same process as drawing them all in advance,
+// so lattices far bigger than MAX_SIZE only need 1 byte per site.
+//
+// Strengths are quantised to N_STRENGTHS levels, and the perimeter is kept in a bucket per level, so finding the weakest site is a lookup in a
+// 3 level bitmap of the non-empty buckets, and every invasion is O(1). Sites in the same bucket are invaded most recent first.
+//
+// With trapping, a site can't be invaded once the region of uninvaded sites around it is cut off from the bottom edge.
+// The invasion with trapping invades the same sites as without it, in the same order, except for the trapped ones, so it's found afterwards:
+// going backwards through the invasion, each site is given back to the uninvaded sites & joined to them with union-find,
+// and it was trapped if the region it joins isn't connected to the bottom edge.
+
+const int STRENGTH_BITS = 18;
+const int N_STRENGTHS = 1 << STRENGTH_BITS; // Levels of strength. 64*64*64, so the bitmap has 3 levels of 64 bit words.
+
+class BucketQueue
+{
+private:
+
+	std::vector<int>* buckets; // Sites waiting at each strength.
+	unsigned long long level0[N_STRENGTHS / 64]; // Bit b is set if bucket b isn't empty.
+	unsigned long long level1[N_STRENGTHS / 4096]; // Bit i is set if level0[i] isn't 0.
+	unsigned long long level2; // Bit i is set if level1[i] isn't 0.
+public:
+	BucketQueue(); // Every bucket empty.
+	~BucketQueue(); // Releases the buckets.
+	void push(int strength, int site); // Adds site at the given strength, in [0, N_STRENGTHS).
+	int pop(int &strength); // Removes a site of the lowest strength, & returns it & its strength. Returns -1 if the queue is empty.
+	void clear(); // Empties every bucket, keeping their memory.
+};
+
+struct InvasionResult {
+	int invaded; // Sites invaded when it broke through, not counting trapped ones.
+	int trapped; // Sites trapped before the breakthrough. Always 0 without trapping.
+	double fraction; // invaded / sites, the same fill fraction as pc_calculation gives for generate_lattice.
+	double threshold; // Largest strength invaded, as a fraction of N_STRENGTHS. Tends to pc for large lattices.
+};
+
+class InvasionLattice
+{
+private:
+
+	int size; // Length of each side of the lattice.
+	unsigned char* state; // UNTOUCHED, PERIMETER, INVADED or TRAPPED for each site, x*size+y.
+	BucketQueue perimeter;
+	std::vector<int> order; // Invaded sites, in the order they were invaded.
+	int* regions; // Union-find of uninvaded regions, for trapping. Entry size*size is the bottom edge. Only allocated the first time trapping is asked for.
+
+	void add_perimeter(int site, std::mt19937 &mt_rand); // Gives an untouched site its strength & puts it on the perimeter.
+	int find_region(int site); // Root of a site's region, with path halving.
+	void join_regions(int a, int b); // Joins the regions of sites a & b.
+	int trap(); // Marks the trapped sites in order, & returns how many there are.
+public:
+	InvasionLattice(int size); // Allocates everything for lattices of this size.
+	~InvasionLattice(); // Releases everything.
+	int get_size(); // Length of each side of the lattice.
+	InvasionResult invade(std::mt19937 &mt_rand, bool trapping = false); // Invades a new lattice from the top edge until it reaches the bottom edge.
+	bool invaded(int x, int y); // Whether (x,y) was invaded (& not trapped) in the last invasion.
+};
+
+void ensemble_invasion(double* data, int size, int nens, std::mt19937 &mt_rand, bool trapping = false); // Does nens invasions, and stores their fill fractions into data.
@@ -0,0 +1,37 @@
+#pragma once
+#include "Point.h"
+#include <random>
+
+// The integer lattice: L[x][y] holds the assigned cluster label of the site, or 0 if it's unoccupied.
+// Proper labels are found through the cluster_labels table with find_proper_label, exactly as for the lattice of Points.
+
+// Flags for the 4 edges of the lattice. A cluster spans when the OR of the edge masks of its sites is ALL_EDGES.
+const int TOP_EDGE = 1; // x == 0
+const int BOTTOM_EDGE = 2; // x == size - 1
+const int LEFT_EDGE = 4; // y == 0
+const int RIGHT_EDGE = 8; // y == size - 1
+const int ALL_EDGES = TOP_EDGE | BOTTOM_EDGE | LEFT_EDGE | RIGHT_EDGE;
+
+int random(std::mt19937 &mt_rand, int size); // Returns an integer in the range [0, size-1].
+
+void print_lattice(int L[MAX_SIZE][MAX_SIZE], int size); // Prints the lattice to stdout.
+
+void initialise_lattice(int L[MAX_SIZE][MAX_SIZE], int size); // Sets every site of the lattice to 0 (unoccupied).
+
+int get_distinct_neighbours(int L[MAX_SIZE][MAX_SIZE], int size, int* cluster_labels, int x, int y, int distinct_neighbours[N_NEIGHBOURS]); // Saves the distinct nonzero proper labels around (x,y) into distinct_neighbours, sorted, and returns how many there are.
+
+int find_spanning_cluster(int L[MAX_SIZE][MAX_SIZE], int size, int* cluster_labels); // Finds the cluster present on all 4 edges, and outputs its proper label. Outputs 0 otherwise.
+
+bool on_edge(int x, int y, int size); // True if (x,y) is on one of the 4 edges of the lattice.
+
+int edge_mask(int x, int y, int size); // The edges (x,y) is on, as an OR of the *_EDGE flags above.
+
+double pc_calculation(int L[MAX_SIZE][MAX_SIZE], int size); // Fraction of occupied sites in the lattice.
+
+bool pc_calculation_to_file(const char* filename, double* data, int n); // Outputs the array "data" of size "n" to given filename, delimited by newlines.
+
+bool print_lattice_to_file(const char* filename, int L[MAX_SIZE][MAX_SIZE], int size); // Same as print_lattice, except to a file.
+
+double generate_lattice(int size, std::mt19937 &mt_rand); // Occupies random sites until a spanning cluster appears, and returns the fraction of occupied sites.
+
+void ensemble_lattice(double* data, int size, int nens, std::mt19937 &mt_rand); // Does nens runs of generate_lattice, and stores their pcs into data.
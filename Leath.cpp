@@ -0,0 +1,142 @@
+#include "Leath.h"
+#include "Point.h"
+#include "Instrumentation.h"
+#include <iostream>
+#include <cstring>
+
+using namespace std;
+
+
+PagedLattice::PagedLattice() : last_key(0), last_page(NULL) {
+}
+
+PagedLattice::~PagedLattice() {
+	clear();
+	for (size_t i = 0; i < spare.size(); i++) delete spare[i];
+}
+
+PagedLattice::Page* PagedLattice::page(int x, int y, bool allocate) {
+	/* Page coordinates are x & y shifted down, so negative coordinates get pages of their own too.
+		They're packed as unsigned, as shifting a negative value left is undefined. */
+
+	long long key = (long long)(((unsigned long long)(unsigned int)(x >> PAGE_BITS) << 32) | (unsigned int)(y >> PAGE_BITS));
+	if (last_page != NULL && key == last_key) return last_page;
+
+	unordered_map<long long, Page*>::iterator found = pages.find(key);
+	Page* p;
+	if (found != pages.end()) p = found->second;
+	else if (!allocate) return NULL;
+	else {
+		if (spare.empty()) p = new Page;
+		else {
+			p = spare.back();
+			spare.pop_back();
+		}
+		memset(p->state, UNKNOWN, sizeof(p->state));
+		pages[key] = p;
+	}
+	last_key = key;
+	last_page = p;
+	return p;
+}
+
+void PagedLattice::clear() {
+	for (unordered_map<long long, Page*>::iterator i = pages.begin(); i != pages.end(); ++i) spare.push_back(i->second);
+	pages.clear();
+	last_page = NULL;
+}
+
+unsigned char PagedLattice::get(int x, int y) {
+	Page* p = page(x, y, false);
+	if (p == NULL) return UNKNOWN;
+	return p->state[(x & (PAGE_SIDE - 1)) * PAGE_SIDE + (y & (PAGE_SIDE - 1))];
+}
+
+void PagedLattice::set(int x, int y, unsigned char state) {
+	page(x, y, true)->state[(x & (PAGE_SIDE - 1)) * PAGE_SIDE + (y & (PAGE_SIDE - 1))] = state;
+}
+
+int PagedLattice::get_n_pages() {
+	return (int)pages.size();
+}
+
+
+
+GrowthResult LeathCluster::grow(double p, int max_size, mt19937 &mt_rand) {
+	/* Each generation looks at the unknown neighbours of the one before, & decides them there & then.
+		The centre of mass & radius of gyration come from running sums of x, y & x^2 + y^2. */
+
+	GrowthResult result = { 0, 0, 0, 0, false };
+	if (p < 0 || p > 1) {
+		cout << "ERROR: p must be a double in the range [0,1]" << endl;
+		return result;
+	}
+
+	const int dx[N_NEIGHBOURS] = { -1, 1, 0, 0 };
+	const int dy[N_NEIGHBOURS] = { 0, 0, -1, 1 };
+	double sum_x = 0, sum_y = 0, sum_r2 = 0;
+	int x, y, nx, ny;
+
+	INSTRUMENT_PHASE_BEGIN(PHASE_GENERATE);
+	lattice.clear();
+	frontier.clear();
+	lattice.set(0, 0, OCCUPIED);
+	frontier.push_back(0);
+	frontier.push_back(0);
+	result.size = 1;
+
+	while (!frontier.empty()) {
+		next.clear();
+		for (size_t i = 0; i < frontier.size(); i += 2) {
+			x = frontier[i];
+			y = frontier[i + 1];
+			sum_x += x;
+			sum_y += y;
+			sum_r2 += (double)x*x + (double)y*y;
+
+			for (int k = 0; k < N_NEIGHBOURS; k++) {
+				nx = x + dx[k];
+				ny = y + dy[k];
+				if (lattice.get(nx, ny) != UNKNOWN) continue;
+				if (result.size < max_size && randreal(mt_rand, p)) {
+					lattice.set(nx, ny, OCCUPIED);
+					next.push_back(nx);
+					next.push_back(ny);
+					result.size++;
+				}
+				else if (result.size < max_size) {
+					lattice.set(nx, ny, EMPTY);
+					result.perimeter++;
+				}
+				else result.truncated = true; // Left unknown.
+			}
+		}
+		frontier.swap(next);
+		if (!frontier.empty()) result.generations++;
+	}
+	INSTRUMENT_PHASE_END(PHASE_GENERATE);
+
+	double cx = sum_x / result.size, cy = sum_y / result.size;
+	result.radius_squared = sum_r2 / result.size - cx*cx - cy*cy;
+	return result;
+}
+
+bool LeathCluster::occupied(int x, int y) {
+	return lattice.get(x, y) == OCCUPIED;
+}
+
+int LeathCluster::get_n_pages() {
+	return lattice.get_n_pages();
+}
+
+
+
+void ensemble_leath(GrowthResult* data, double p, int nens, int max_size, mt19937 &mt_rand) {
+	/* One LeathCluster for the whole ensemble, so its pages are only allocated once. */
+
+	LeathCluster C;
+	for (int i = 0; i < nens; i++) {
+		data[i] = C.grow(p, max_size, mt_rand);
+		INSTRUMENT_POLL();
+	}
+}
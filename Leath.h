@@ -0,0 +1,67 @@
+#pragma once
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+// Leath growth of a single cluster from a seed at (0,0), on a lattice with no edges.
+// Each site's occupation is only decided the first time the cluster touches it: occupied with probability p, and joined to the cluster,
+// or empty for good. That gives exactly the cluster of the origin in a lattice of occupation probability p, given the origin is occupied,
+// without making or labelling anything the cluster never touches.
+//
+// The sites touched are kept in 64 x 64 pages, allocated the first time anything in them is touched & found through a hash map,
+// so memory & time go with the cluster & its perimeter instead of size*size. Pages are kept for the next cluster instead of freed.
+// The growth is breadth-first, 1 generation at a time, so a site's generation is its chemical distance from the seed.
+
+const int PAGE_BITS = 6;
+const int PAGE_SIDE = 1 << PAGE_BITS; // Sites along each side of a page.
+
+class PagedLattice
+{
+private:
+
+	struct Page {
+		unsigned char state[PAGE_SIDE * PAGE_SIDE]; // UNKNOWN, OCCUPIED or EMPTY for each site.
+	};
+
+	std::unordered_map<long long, Page*> pages; // Pages in use, by page coordinates.
+	std::vector<Page*> spare; // Pages from earlier clusters, ready to be reused.
+	long long last_key; // The page looked up last, as most lookups are next to the one before.
+	Page* last_page;
+
+	Page* page(int x, int y, bool allocate); // The page holding (x,y). If it isn't there yet, it's allocated, or NULL is returned if allocate is false.
+public:
+	PagedLattice(); // No pages yet.
+	~PagedLattice(); // Releases every page.
+	void clear(); // Makes every site unknown again, keeping the pages for reuse.
+	unsigned char get(int x, int y); // State of (x,y). Never allocates.
+	void set(int x, int y, unsigned char state); // Sets the state of (x,y).
+	int get_n_pages(); // Pages in use.
+};
+
+// States of a site.
+const unsigned char UNKNOWN = 0; // Not touched yet.
+const unsigned char OCCUPIED = 1; // In the cluster.
+const unsigned char EMPTY = 2; // On the perimeter, and unoccupied.
+
+struct GrowthResult {
+	int size; // Sites in the cluster.
+	int perimeter; // Empty sites next to the cluster.
+	int generations; // Largest chemical distance from the seed, ie. the number of generations it grew for.
+	double radius_squared; // Radius of gyration squared: mean squared distance of the sites from their centre of mass.
+	bool truncated; // Still growing when it reached max_size, so size is only a lower bound.
+};
+
+class LeathCluster
+{
+private:
+
+	PagedLattice lattice;
+	std::vector<int> frontier; // Coordinates of the current generation, then the next, as (x,y) pairs.
+	std::vector<int> next;
+public:
+	GrowthResult grow(double p, int max_size, std::mt19937 &mt_rand); // Grows a new cluster from the seed, stopping once it has max_size sites.
+	bool occupied(int x, int y); // Whether (x,y) is in the last cluster grown.
+	int get_n_pages(); // Pages the last cluster used.
+};
+
+void ensemble_leath(GrowthResult* data, double p, int nens, int max_size, std::mt19937 &mt_rand); // Grows nens clusters, and stores their results into data.
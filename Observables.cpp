@@ -0,0 +1,156 @@
+#include "Observables.h"
+#include <iostream>
+
+using namespace std;
+
+
+ObservablePipeline::ObservablePipeline() : n_observers(0) {
+	/*Start off with no observers.*/
+}
+
+bool ObservablePipeline::add(ClusterObserver* observer) {
+	/*Register an observer, if there's room for it.*/
+	if (n_observers == MAX_OBSERVERS) {
+		cout << "ERROR: Too many observers in pipeline" << endl;
+		return false;
+	}
+	observers[n_observers] = observer;
+	n_observers++;
+	return true;
+}
+
+void ObservablePipeline::run(int* cluster_labels, int n_labels, int spanning_cluster, int n_sites) {
+	/* Go through the assigned labels [1, n_labels) once. A non-negative entry is a proper label, and holds the size of its cluster.
+		Negative entries are references to other labels, so they're skipped. Labels that were never given a site have size 0, and are skipped too.
+		The cost of this is O(n_labels), however many observers there are.
+	*/
+
+	for (int k = 0; k < n_observers; k++) observers[k]->begin(n_sites, spanning_cluster);
+
+	int size;
+	for (int c = 1; c < n_labels; c++) {
+
+		size = cluster_labels[c];
+		if (size <= 0) continue; // Reference, or empty label.
+
+		for (int k = 0; k < n_observers; k++) observers[k]->cluster(c, size, c == spanning_cluster);
+	}
+
+	for (int k = 0; k < n_observers; k++) observers[k]->end();
+}
+
+
+
+void FObserver::begin(int, int) {
+	total = 0;
+	spanning_total = 0;
+}
+
+void FObserver::cluster(int, int size, bool spanning) {
+	total += size;
+	if (spanning) spanning_total = size;
+}
+
+double FObserver::get_F() {
+	if (spanning_total == 0) return -1; // No spanning cluster.
+	return (double)spanning_total / total;
+}
+
+
+
+void PInfinityObserver::begin(int n_sites, int) {
+	this->n_sites = n_sites;
+	spanning_total = 0;
+}
+
+void PInfinityObserver::cluster(int, int size, bool spanning) {
+	if (spanning) spanning_total = size;
+}
+
+double PInfinityObserver::get_P() {
+	return (double)spanning_total / n_sites;
+}
+
+
+
+void MeanClusterSizeObserver::begin(int, int) {
+	sum_s = 0;
+	sum_s2 = 0;
+}
+
+void MeanClusterSizeObserver::cluster(int, int size, bool spanning) {
+	if (spanning) return; // Only finite clusters count.
+	sum_s += size;
+	sum_s2 += (double)size * size;
+}
+
+double MeanClusterSizeObserver::get_S() {
+	if (sum_s == 0) return 0;
+	return sum_s2 / sum_s;
+}
+
+
+
+ClusterDistributionObserver::ClusterDistributionObserver() : n_sites(0) {
+	/*No counts yet. They grow to the largest cluster seen.*/
+}
+
+void ClusterDistributionObserver::begin(int n_sites, int) {
+	/*Only the sizes the last pass counted are zeroed, so a pass costs O(#clusters) however big the lattice is.*/
+	this->n_sites = n_sites;
+	for (size_t i = 0; i < touched.size(); i++) counts[touched[i]] = 0;
+	touched.clear();
+}
+
+void ClusterDistributionObserver::cluster(int, int size, bool spanning) {
+	if (spanning) return;
+	if (size >= (int)counts.size()) counts.resize(size + 1, 0);
+	if (counts[size] == 0) touched.push_back(size);
+	counts[size]++;
+}
+
+double ClusterDistributionObserver::get_n(int s) {
+	return (double)get_count(s) / n_sites;
+}
+
+int ClusterDistributionObserver::get_count(int s) {
+	if (s < 0 || s >= (int)counts.size()) return 0;
+	return counts[s];
+}
+
+
+
+void LargestClusterObserver::begin(int, int) {
+	largest = 0;
+	second_largest = 0;
+}
+
+void LargestClusterObserver::cluster(int, int size, bool) {
+	if (size > largest) {
+		second_largest = largest;
+		largest = size;
+	}
+	else if (size > second_largest) second_largest = size;
+}
+
+int LargestClusterObserver::get_largest() {
+	return largest;
+}
+
+int LargestClusterObserver::get_second_largest() {
+	return second_largest;
+}
+
+
+
+void ClusterCountObserver::begin(int, int) {
+	n_clusters = 0;
+}
+
+void ClusterCountObserver::cluster(int, int, bool) {
+	n_clusters++;
+}
+
+int ClusterCountObserver::get_count() {
+	return n_clusters;
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include <vector>
+
+// Observables measured from the cluster_labels table once the lattice has been labelled.
+// The entry of each proper label holds the size of its cluster, so every observable can be computed from one pass over the table,
+// without looking at the lattice again. Each observable is a ClusterObserver, and an ObservablePipeline feeds every cluster to all of them at once.
+
+const int MAX_OBSERVERS = 16; // Max number of observers in one pipeline.
+
+class ClusterObserver
+{
+public:
+	virtual ~ClusterObserver() {}
+	virtual void begin(int /*n_sites*/, int /*spanning_cluster*/) {} // Called before the pass, with the number of sites in the lattice & the spanning cluster (0 if none).
+	virtual void cluster(int label, int size, bool spanning) = 0; // Called once for every cluster.
+	virtual void end() {} // Called after the pass.
+};
+
+class ObservablePipeline
+{
+private:
+
+	ClusterObserver* observers[MAX_OBSERVERS]; // The registered observers. Not owned by the pipeline.
+	int n_observers; // Number of registered observers.
+public:
+	ObservablePipeline(); // Pipeline with no observers.
+	bool add(ClusterObserver* observer); // Registers an observer. Returns false if the pipeline is full.
+	void run(int* cluster_labels, int n_labels, int spanning_cluster, int n_sites); // Feeds every proper label in [1, n_labels) to every observer.
+};
+
+class FObserver : public ClusterObserver // F = sites in spanning cluster / occupied sites.
+{
+private:
+
+	int total; // Occupied sites.
+	int spanning_total; // Occupied sites in the spanning cluster.
+public:
+	void begin(int n_sites, int spanning_cluster);
+	void cluster(int label, int size, bool spanning);
+	double get_F(); // Returns F, or -1 if there's no spanning cluster.
+};
+
+class PInfinityObserver : public ClusterObserver // P = sites in spanning cluster / sites in lattice.
+{
+private:
+
+	int n_sites; // Sites in lattice.
+	int spanning_total; // Occupied sites in the spanning cluster.
+public:
+	void begin(int n_sites, int spanning_cluster);
+	void cluster(int label, int size, bool spanning);
+	double get_P(); // Returns P, which is 0 if there's no spanning cluster.
+};
+
+class MeanClusterSizeObserver : public ClusterObserver // S = sum of s^2 / sum of s, over the finite (non-spanning) clusters.
+{
+private:
+
+	double sum_s; // Sum of the sizes of the finite clusters.
+	double sum_s2; // Sum of the squared sizes of the finite clusters.
+public:
+	void begin(int n_sites, int spanning_cluster);
+	void cluster(int label, int size, bool spanning);
+	double get_S(); // Returns S, or 0 if there are no finite clusters.
+};
+
+class ClusterDistributionObserver : public ClusterObserver // n_s = number of finite clusters of size s / sites in lattice.
+{
+private:
+
+	int n_sites; // Sites in lattice.
+	std::vector<int> counts; // counts[s] is the number of finite clusters of size s. Grows to the largest size seen.
+	std::vector<int> touched; // Sizes counted in the last pass, so only they need zeroing in the next.
+public:
+	ClusterDistributionObserver();
+	void begin(int n_sites, int spanning_cluster);
+	void cluster(int label, int size, bool spanning);
+	double get_n(int s); // Returns n_s.
+	int get_count(int s); // Returns the number of finite clusters of size s.
+};
+
+class LargestClusterObserver : public ClusterObserver // Sizes of the largest & second largest clusters, spanning or not.
+{
+private:
+
+	int largest;
+	int second_largest;
+public:
+	void begin(int n_sites, int spanning_cluster);
+	void cluster(int label, int size, bool spanning);
+	int get_largest();
+	int get_second_largest();
+};
+
+class ClusterCountObserver : public ClusterObserver // Number of clusters, spanning or not.
+{
+private:
+
+	int n_clusters;
+public:
+	void begin(int n_sites, int spanning_cluster);
+	void cluster(int label, int size, bool spanning);
+	int get_count();
+};
@@ -0,0 +1,325 @@
+#include "OccupancyImage.h"
+#include "Instrumentation.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <cstring>
+#include <climits>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+
+OccupancyImage::OccupancyImage() : data(NULL), file_size(0), width(0), height(0), format(RAW_FORMAT), row_bytes(0) {
+#ifdef _WIN32
+	file_handle = INVALID_HANDLE_VALUE;
+	mapping_handle = NULL;
+#else
+	file_descriptor = -1;
+#endif
+}
+
+OccupancyImage::~OccupancyImage() {
+	close();
+}
+
+int OccupancyImage::get_width() {
+	return width;
+}
+
+int OccupancyImage::get_height() {
+	return height;
+}
+
+int OccupancyImage::get_format() {
+	return format;
+}
+
+bool OccupancyImage::open(const char* filename) {
+	/* Map the whole file read-only, then check the header against the size of the file. */
+
+	close();
+
+#ifdef _WIN32
+	file_handle = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file_handle == INVALID_HANDLE_VALUE) {
+		cout << "ERROR: Can't open " << filename << endl;
+		return false;
+	}
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file_handle, &size)) {
+		cout << "ERROR: Can't read the size of " << filename << endl;
+		close();
+		return false;
+	}
+	file_size = (size_t)size.QuadPart;
+	if (file_size >= (size_t)IMAGE_HEADER_SIZE) {
+		mapping_handle = CreateFileMappingA(file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping_handle != NULL) data = (const unsigned char*)MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0);
+	}
+#else
+	file_descriptor = ::open(filename, O_RDONLY);
+	if (file_descriptor < 0) {
+		cout << "ERROR: Can't open " << filename << endl;
+		return false;
+	}
+	struct stat info;
+	if (fstat(file_descriptor, &info) != 0) {
+		cout << "ERROR: Can't read the size of " << filename << endl;
+		close();
+		return false;
+	}
+	file_size = (size_t)info.st_size;
+	if (file_size >= (size_t)IMAGE_HEADER_SIZE) {
+		void* mapped = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+		if (mapped != MAP_FAILED) {
+			data = (const unsigned char*)mapped;
+			madvise(mapped, file_size, MADV_SEQUENTIAL); // Read front to back, once.
+		}
+	}
+#endif
+
+	if (data == NULL) {
+		cout << "ERROR: Can't map " << filename << endl;
+		close();
+		return false;
+	}
+
+	// The header is little-endian, so read it byte by byte.
+	unsigned int fields[3];
+	for (int f = 0; f < 3; f++) {
+		const unsigned char* b = data + 4 + 4 * f;
+		fields[f] = b[0] | (b[1] << 8) | (b[2] << 16) | ((unsigned int)b[3] << 24);
+	}
+
+	if (memcmp(data, "PERC", 4) != 0 || fields[0] == 0 || fields[1] == 0 || fields[0] > INT_MAX || fields[1] > INT_MAX ||
+		(fields[2] != RAW_FORMAT && fields[2] != PACKED_FORMAT)) {
+		cout << "ERROR: " << filename << " is not an occupancy image" << endl;
+		close();
+		return false;
+	}
+
+	width = (int)fields[0];
+	height = (int)fields[1];
+	format = (int)fields[2];
+	row_bytes = format == RAW_FORMAT ? (size_t)width : ((size_t)width + 7) / 8;
+
+	if (file_size < IMAGE_HEADER_SIZE + row_bytes * height) {
+		cout << "ERROR: " << filename << " is shorter than its header says" << endl;
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void OccupancyImage::close() {
+#ifdef _WIN32
+	if (data != NULL) UnmapViewOfFile(data);
+	if (mapping_handle != NULL) CloseHandle(mapping_handle);
+	if (file_handle != INVALID_HANDLE_VALUE) CloseHandle(file_handle);
+	mapping_handle = NULL;
+	file_handle = INVALID_HANDLE_VALUE;
+#else
+	if (data != NULL) munmap((void*)data, file_size);
+	if (file_descriptor >= 0) ::close(file_descriptor);
+	file_descriptor = -1;
+#endif
+	data = NULL;
+	file_size = 0;
+	width = 0;
+	height = 0;
+}
+
+
+
+bool write_occupancy_image(const char* filename, int L[MAX_SIZE][MAX_SIZE], int size, int format) {
+	/* Any nonzero site is occupied. */
+
+	ofstream outfile(filename, ios::out | ios::binary);
+	if (!outfile) {
+		cout << "Failed to create file" << endl;
+		return EXIT_FAILURE;
+	}
+
+	unsigned char header[IMAGE_HEADER_SIZE] = { 'P', 'E', 'R', 'C' };
+	unsigned int fields[3] = { (unsigned int)size, (unsigned int)size, (unsigned int)format };
+	for (int f = 0; f < 3; f++) {
+		for (int b = 0; b < 4; b++) header[4 + 4 * f + b] = (unsigned char)(fields[f] >> (8 * b));
+	}
+	outfile.write((const char*)header, IMAGE_HEADER_SIZE);
+
+	vector<unsigned char> row(format == RAW_FORMAT ? size : (size + 7) / 8);
+	for (int i = 0; i < size; i++) {
+		fill(row.begin(), row.end(), 0);
+		for (int j = 0; j < size; j++) {
+			if (L[i][j] == 0) continue;
+			if (format == RAW_FORMAT) row[j] = 1;
+			else row[j >> 3] |= (unsigned char)(1 << (j & 7));
+		}
+		outfile.write((const char*)row.data(), row.size());
+	}
+
+	outfile.close();
+	return EXIT_SUCCESS;
+}
+
+
+
+// The union-find over the provisional labels of an image. Same convention as cluster_labels everywhere else: a negative entry references
+// another label, and a proper label holds the size of its cluster. Grows as labels are handed out, as the number of clusters isn't known in advance.
+// Labels & sizes are 64 bit, as an image can have more than 2^31 sites.
+struct ImageClusters {
+	vector<long long> cluster_labels;
+	vector<unsigned char> edges; // Edges touched by each cluster, while its label is proper.
+
+	long long find(long long c) {
+		long long root = c;
+		while (cluster_labels[root] < 0) root = -cluster_labels[root];
+		long long next;
+		while (c != root) { // Point the whole path straight at the proper label.
+			next = -cluster_labels[c];
+			cluster_labels[c] = -root;
+			c = next;
+		}
+		return root;
+	}
+
+	void merge(long long a, long long b) {
+		a = find(a);
+		b = find(b);
+		if (a == b) return;
+		if (b < a) swap(a, b); // Keep the smaller label.
+		cluster_labels[a] += cluster_labels[b];
+		edges[a] |= edges[b];
+		cluster_labels[b] = -a;
+		INSTRUMENT_COUNT(UNIONS, 1);
+	}
+};
+
+static void scan_image(OccupancyImage &image, ImageClusters &clusters, ofstream* labels_file) {
+	/* Hoshen-Kopelman, 1 row at a time: a site takes the label of its left neighbour, or else the one above, or else a new one,
+		and links the two if both are occupied. Only the labels of the previous row are kept.
+		The labels handed out only depend on the image, so the second pass (labels_file != NULL) hands out exactly the same ones,
+		and writes their proper labels instead of linking them again. */
+
+	int width = image.get_width(), height = image.get_height();
+	vector<long long> previous(width, 0), current(width, 0);
+	long long next_label = 1;
+	long long left, up, label;
+	unsigned char mask;
+	const unsigned char* row;
+
+	for (int x = 0; x < height; x++) {
+		row = image.get_row(x);
+		for (int y = 0; y < width; y++) {
+			if (!image.occupied(row, y)) {
+				current[y] = 0;
+				if (labels_file != NULL) *labels_file << setw(4) << 0 << " ";
+				continue;
+			}
+
+			left = y > 0 ? current[y - 1] : 0;
+			up = previous[y];
+			mask = (unsigned char)((x == 0 ? TOP_EDGE : 0) | (x == height - 1 ? BOTTOM_EDGE : 0) | (y == 0 ? LEFT_EDGE : 0) | (y == width - 1 ? RIGHT_EDGE : 0));
+
+			if (left == 0 && up == 0) { // It's a new cluster
+				label = next_label++;
+				if (labels_file == NULL) {
+					clusters.cluster_labels.push_back(1);
+					clusters.edges.push_back(mask);
+				}
+			}
+			else {
+				label = left != 0 ? left : up;
+				if (labels_file == NULL) {
+					long long root = clusters.find(label);
+					clusters.cluster_labels[root]++;
+					clusters.edges[root] |= mask;
+					if (left != 0 && up != 0) clusters.merge(left, up);
+				}
+			}
+			current[y] = label;
+
+			if (labels_file != NULL) *labels_file << setw(4) << clusters.find(label) << " ";
+		}
+		if (labels_file != NULL) *labels_file << endl;
+		previous.swap(current);
+	}
+}
+
+long long label_image(OccupancyImage &image, ImageStatistics &statistics, const char* labels_filename, ObservablePipeline* pipeline) {
+	/* Label the whole image, then measure it from the label table in 1 pass over the labels, with 64 bit sizes throughout.
+		The observers in pipeline take sizes & site counts as ints, so they're only run on images with fewer than 2^31 sites. */
+
+	if (image.get_width() == 0) {
+		cout << "ERROR: No occupancy image open" << endl;
+		return -1;
+	}
+	long long n_sites = (long long)image.get_width() * image.get_height();
+
+	ImageClusters clusters;
+	clusters.cluster_labels.push_back(0); // 0 is unoccupied.
+	clusters.edges.push_back(0);
+
+	INSTRUMENT_PHASE_BEGIN(PHASE_LABEL);
+	scan_image(image, clusters, NULL);
+	INSTRUMENT_PHASE_END(PHASE_LABEL);
+
+	// At most 1 cluster can touch all 4 edges.
+	INSTRUMENT_PHASE_BEGIN(PHASE_MEASURE);
+	INSTRUMENT_COUNT(SPANNING_CHECKS, 1);
+	long long n_labels = (long long)clusters.cluster_labels.size();
+	long long size;
+	statistics.n_occupied = 0;
+	statistics.n_clusters = 0;
+	statistics.largest = 0;
+	statistics.spanning_cluster = 0;
+	for (long long c = 1; c < n_labels; c++) {
+		size = clusters.cluster_labels[c];
+		if (size <= 0) continue;
+		statistics.n_occupied += size;
+		statistics.n_clusters++;
+		if (size > statistics.largest) statistics.largest = size;
+		if (statistics.spanning_cluster == 0 && clusters.edges[c] == ALL_EDGES) statistics.spanning_cluster = c;
+	}
+
+	// Same as FObserver & PInfinityObserver.
+	long long spanning_size = statistics.spanning_cluster == 0 ? 0 : clusters.cluster_labels[statistics.spanning_cluster];
+	statistics.F = statistics.spanning_cluster == 0 ? -1 : (double)spanning_size / statistics.n_occupied;
+	statistics.P = (double)spanning_size / n_sites;
+
+	if (pipeline != NULL) {
+		if (n_sites > INT_MAX) cout << "ERROR: Observers need fewer than 2^31 sites, so they weren't run on this image" << endl;
+		else {
+			vector<int> labels(clusters.cluster_labels.begin(), clusters.cluster_labels.end());
+			pipeline->run(labels.data(), (int)n_labels, (int)statistics.spanning_cluster, (int)n_sites);
+		}
+	}
+	INSTRUMENT_PHASE_END(PHASE_MEASURE);
+
+	if (labels_filename != NULL) {
+		INSTRUMENT_PHASE_BEGIN(PHASE_WRITE);
+		ofstream outfile(labels_filename, ios::out);
+		if (!outfile) {
+			cout << "Failed to create file" << endl;
+			INSTRUMENT_PHASE_END(PHASE_WRITE);
+			return -1;
+		}
+		scan_image(image, clusters, &outfile);
+		INSTRUMENT_COUNT(BYTES_WRITTEN, (long long)outfile.tellp());
+		outfile.close();
+		INSTRUMENT_PHASE_END(PHASE_WRITE);
+	}
+
+	return statistics.n_clusters;
+}
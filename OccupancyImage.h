@@ -0,0 +1,63 @@
+#pragma once
+#include "Lattice.h"
+#include "Observables.h"
+#include <cstddef>
+#include <vector>
+
+// Occupancy images, e.g. thresholded micro-CT slices, read straight from a memory-mapped file, so images far bigger than MAX_SIZE can be
+// labelled without parsing or copying them. The operating system pages the file in as the labelling reads it, row by row.
+//
+// File layout: a 16 byte header, then the rows, top row first.
+//	bytes 0-3: "PERC"
+//	bytes 4-7: width (sites per row), bytes 8-11: height (rows), bytes 12-15: format. All little-endian unsigned 32 bit.
+//	RAW_FORMAT: 1 byte per site, nonzero is occupied.
+//	PACKED_FORMAT: 1 bit per site, lowest bit first, each row padded to a whole number of bytes.
+//
+// Sites are (x,y) with x the row, as in L[x][y], and spanning means touching all 4 edges, as everywhere else.
+
+const int RAW_FORMAT = 0;
+const int PACKED_FORMAT = 1;
+const int IMAGE_HEADER_SIZE = 16;
+
+class OccupancyImage
+{
+private:
+
+	const unsigned char* data; // The whole mapped file, or NULL if nothing is open.
+	size_t file_size;
+	int width; // Sites per row.
+	int height; // Number of rows.
+	int format; // RAW_FORMAT or PACKED_FORMAT
+	size_t row_bytes; // Bytes per row in the file.
+#ifdef _WIN32
+	void* file_handle;
+	void* mapping_handle;
+#else
+	int file_descriptor;
+#endif
+public:
+	OccupancyImage(); // Nothing open yet.
+	~OccupancyImage(); // Unmaps the file, if one is open.
+	bool open(const char* filename); // Maps the file & checks its header. Returns false if it can't be used.
+	void close(); // Unmaps the file.
+
+	int get_width(); // Sites per row.
+	int get_height(); // Number of rows.
+	int get_format(); // RAW_FORMAT or PACKED_FORMAT
+
+	const unsigned char* get_row(int x) { return data + IMAGE_HEADER_SIZE + (size_t)x * row_bytes; } // Start of row x in the file.
+	bool occupied(const unsigned char* row, int y) { return format == RAW_FORMAT ? row[y] != 0 : ((row[y >> 3] >> (y & 7)) & 1) != 0; } // Whether site y of a row from get_row is occupied.
+};
+
+struct ImageStatistics {
+	long long n_occupied; // Occupied sites.
+	long long n_clusters; // Number of clusters.
+	long long largest; // Size of the largest cluster.
+	long long spanning_cluster; // Proper label of the cluster touching all 4 edges, or 0.
+	double F; // Sites in the spanning cluster / occupied sites, or -1 if there's no spanning cluster, as in F_calculation.
+	double P; // Sites in the spanning cluster / sites.
+};
+
+bool write_occupancy_image(const char* filename, int L[MAX_SIZE][MAX_SIZE], int size, int format); // Writes the occupied sites of a lattice as an occupancy image.
+
+long long label_image(OccupancyImage &image, ImageStatistics &statistics, const char* labels_filename = NULL, ObservablePipeline* pipeline = NULL); // Labels the image & measures it. If labels_filename isn't NULL, also writes the proper label of every site there, in the same format as print_lattice_to_file. Any observers in pipeline are run too, if the image has fewer than 2^31 sites. Returns the number of clusters, or -1 on an error.
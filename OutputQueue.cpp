@@ -0,0 +1,281 @@
+#include "OutputQueue.h"
+#include "Instrumentation.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+
+using namespace std;
+
+
+const size_t BUFFER_LIMIT = 1 << 20; // A buffer is handed to the flusher once it holds this many bytes.
+
+
+OutputQueue::OutputQueue(int capacity) : push_position(0), pop_position(0), next_auto_sequence(0), next_sequence(0), n_waiting(0), n_pushed(0), n_written(0),
+	stopping(false), failures(0), active(0), flusher_done(false) {
+	/* Round the capacity up to a power of 2, so positions can be turned into cells with a mask. Then start both threads. */
+
+	this->capacity = 1;
+	while (this->capacity < capacity) this->capacity *= 2;
+
+	cells = new Cell[this->capacity];
+	for (int i = 0; i < this->capacity; i++) {
+		cells[i].turn = i; // Cell i is ready for the push at position i.
+		cells[i].batch = NULL;
+	}
+
+	for (int i = 0; i < 2; i++) {
+		buffers[i].append = false;
+		buffers[i].n_batches = 0;
+		buffers[i].full = false;
+	}
+
+	writer = thread(&OutputQueue::write_loop, this);
+	flusher = thread(&OutputQueue::flush_loop, this);
+}
+
+OutputQueue::~OutputQueue() {
+	/* Nothing else can be pushed now, so let the writer finish off the ring, and wait for both threads. */
+	stopping.store(true, memory_order_release);
+	writer.join();
+	flusher.join();
+	delete[] cells;
+}
+
+
+
+void OutputQueue::push(OutputBatch* batch) {
+	/* A bounded multi-producer ring. Each cell has a turn, which says which push or pop it's waiting for.
+		A producer claims a position with a compare-exchange, fills the cell, then hands it to the writer by moving its turn on.
+		If the cell is still waiting for the writer, the ring is full, and the producer waits for it - this is the backpressure.
+		A batch too far ahead of the writer waits first, so the batches held back for earlier ones never outgrow the ring either. */
+
+	while (batch->sequence - next_sequence.load(memory_order_acquire) >= capacity) this_thread::yield();
+
+	long long position = push_position.load(memory_order_relaxed);
+	while (true) {
+		Cell& cell = cells[position & (capacity - 1)];
+		long long turn = cell.turn.load(memory_order_acquire);
+
+		if (turn == position) { // Cell is free for this position.
+			if (push_position.compare_exchange_weak(position, position + 1, memory_order_relaxed)) {
+				cell.batch = batch;
+				cell.turn.store(position + 1, memory_order_release); // Ready for the pop at this position.
+				n_pushed.fetch_add(1, memory_order_release);
+				return;
+			}
+			// Another producer got there first; position has been reloaded by compare_exchange_weak.
+		}
+		else if (turn < position) { // Full: the writer hasn't taken this cell's last batch yet.
+			this_thread::yield();
+			position = push_position.load(memory_order_relaxed);
+		}
+		else position = push_position.load(memory_order_relaxed); // Another producer has moved on.
+	}
+}
+
+bool OutputQueue::try_pop(OutputBatch*& batch) {
+	/* Only the writer thread pops, so the pop position needs no compare-exchange. */
+
+	long long position = pop_position.load(memory_order_relaxed);
+	Cell& cell = cells[position & (capacity - 1)];
+
+	if (cell.turn.load(memory_order_acquire) != position + 1) return false; // Nothing pushed here yet.
+
+	batch = cell.batch;
+	cell.turn.store(position + capacity, memory_order_release); // Ready for the push on the next lap.
+	pop_position.store(position + 1, memory_order_relaxed);
+	return true;
+}
+
+
+
+void OutputQueue::results(long long sequence, const char* filename, double* data, int n, bool append) {
+	/* Copy the data, so the caller can reuse its array straight away. */
+	OutputBatch* batch = new OutputBatch;
+	batch->sequence = sequence;
+	batch->kind = RESULTS_BATCH;
+	batch->filename = filename;
+	batch->append = append;
+	batch->data.assign(data, data + n);
+	batch->size = 0;
+	push(batch);
+}
+
+void OutputQueue::results(const char* filename, double* data, int n, bool append) {
+	results(next_auto_sequence.fetch_add(1), filename, data, n, append);
+}
+
+void OutputQueue::snapshot(long long sequence, const char* filename, int L[MAX_SIZE][MAX_SIZE], int size, bool append) {
+	/* Copy the lattice row by row, so the caller can carry on changing it. */
+	OutputBatch* batch = new OutputBatch;
+	batch->sequence = sequence;
+	batch->kind = SNAPSHOT_BATCH;
+	batch->filename = filename;
+	batch->append = append;
+	batch->size = size;
+	batch->lattice.resize(size*size);
+	for (int i = 0; i < size; i++)
+		for (int j = 0; j < size; j++) batch->lattice[i*size + j] = L[i][j];
+	push(batch);
+}
+
+void OutputQueue::snapshot(const char* filename, int L[MAX_SIZE][MAX_SIZE], int size, bool append) {
+	snapshot(next_auto_sequence.fetch_add(1), filename, L, size, append);
+}
+
+void OutputQueue::wait() {
+	/* The writer hands over half-full buffers whenever the ring is empty, and while anyone is waiting it doesn't hold batches back
+		for missing sequence numbers, so this finishes even if there are gaps. */
+	n_waiting++;
+	while (n_written.load(memory_order_acquire) < n_pushed.load(memory_order_acquire)) this_thread::sleep_for(chrono::microseconds(100));
+	n_waiting--;
+}
+
+int OutputQueue::get_failures() {
+	return failures.load();
+}
+
+
+
+void OutputQueue::write_loop() {
+	/* Take batches off the ring, and format them in sequence order. Batches that arrive early wait in "pending". */
+
+	map<long long, OutputBatch*> pending;
+	OutputBatch* batch;
+	bool got, stop;
+
+	while (true) {
+
+		stop = stopping.load(memory_order_acquire); // Read before draining, so that an empty ring after this really is empty for good.
+
+		got = false;
+		while (try_pop(batch)) {
+			pending[batch->sequence] = batch;
+			got = true;
+		}
+
+		format_pending(pending, false);
+
+		if (got) continue;
+
+		// Nothing new came in, so anything still held is waiting for a missing sequence number.
+		// Defensive programming: If someone is waiting for it, or nothing else can come, write it in order anyway.
+		if (!pending.empty() && (stop || n_waiting.load(memory_order_acquire) > 0)) {
+			cout << "ERROR: Output sequence numbers have gaps; writing the rest in order" << endl;
+			format_pending(pending, true);
+		}
+
+		// Hand over what's been formatted so far, so it doesn't wait for a full buffer.
+		if (buffers[active].n_batches > 0) hand_over();
+
+		if (stop) break;
+
+		this_thread::sleep_for(chrono::microseconds(50));
+	}
+
+	// Tell the flusher no more buffers are coming.
+	lock_guard<mutex> lock(buffer_mutex);
+	flusher_done = true;
+	buffer_ready.notify_one();
+}
+
+void OutputQueue::format_pending(map<long long, OutputBatch*>& pending, bool skip_gaps) {
+	/* Batches from before next_sequence only turn up late, after a gap was skipped, so they're written as soon as they arrive. */
+
+	long long sequence;
+	while (!pending.empty() && (skip_gaps || pending.begin()->first <= next_sequence.load(memory_order_relaxed))) {
+		sequence = pending.begin()->first;
+		format(pending.begin()->second);
+		delete pending.begin()->second;
+		pending.erase(pending.begin());
+		if (sequence >= next_sequence.load(memory_order_relaxed)) next_sequence.store(sequence + 1, memory_order_release);
+	}
+}
+
+void OutputQueue::format(OutputBatch* batch) {
+	/* Batches appended to the same file go into the same buffer, until it's big enough. Anything else starts a new buffer. */
+
+	Buffer* buffer = &buffers[active];
+	if (buffer->n_batches > 0 && !(batch->append && batch->filename == buffer->filename && buffer->text.size() < BUFFER_LIMIT)) {
+		hand_over();
+		buffer = &buffers[active];
+	}
+
+	if (buffer->n_batches == 0) {
+		buffer->filename = batch->filename;
+		buffer->append = batch->append;
+	}
+
+	ostringstream out;
+	if (batch->kind == RESULTS_BATCH) {
+		// Same as F_calculation_to_file. Appended batches also end with a newline, so that the next batch starts on a new line.
+		for (size_t i = 0; i < batch->data.size(); i++) {
+			out << batch->data[i];
+			if (i + 1 < batch->data.size() || batch->append) out << endl;
+		}
+	}
+	else {
+		// Same as print_lattice_to_file.
+		for (int i = 0; i < batch->size; i++) {
+			for (int j = 0; j < batch->size; j++) out << setw(4) << batch->lattice[i*batch->size + j] << " ";
+			out << endl;
+		}
+	}
+
+	buffer->text += out.str();
+	buffer->n_batches++;
+}
+
+void OutputQueue::hand_over() {
+	/* Mark the active buffer full for the flusher, and carry on in the other one once the flusher has finished with it. */
+
+	unique_lock<mutex> lock(buffer_mutex);
+	buffers[active].full = true;
+	buffer_ready.notify_one();
+
+	active = 1 - active;
+	buffer_free.wait(lock, [this] { return !buffers[active].full; });
+
+	buffers[active].text.clear();
+	buffers[active].n_batches = 0;
+}
+
+void OutputQueue::flush_loop() {
+	/* Write the full buffers in the order they were filled, which alternates between the 2. */
+
+	int next = 0; // The buffer that's filled next.
+	while (true) {
+
+		{
+			unique_lock<mutex> lock(buffer_mutex);
+			buffer_ready.wait(lock, [this, next] { return buffers[next].full || flusher_done; });
+			if (!buffers[next].full) return; // Writer is done, and there's nothing left.
+		}
+
+		// The buffer belongs to this thread until it's marked empty again, so it's written without holding the lock.
+		Buffer& buffer = buffers[next];
+		INSTRUMENT_PHASE_BEGIN(PHASE_WRITE);
+		ofstream outfile(buffer.filename.c_str(), buffer.append ? ios::app : ios::out);
+		if (!outfile) {
+			cout << "Failed to create file" << endl;
+			failures++;
+		}
+		else {
+			outfile << buffer.text;
+			INSTRUMENT_COUNT(BYTES_WRITTEN, (long long)buffer.text.size());
+			outfile.close();
+		}
+		INSTRUMENT_PHASE_END(PHASE_WRITE);
+
+		{
+			lock_guard<mutex> lock(buffer_mutex);
+			n_written.fetch_add(buffer.n_batches, memory_order_release);
+			buffer.full = false;
+			buffer_free.notify_one();
+		}
+
+		next = 1 - next;
+	}
+}
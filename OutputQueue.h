@@ -0,0 +1,95 @@
+#pragma once
+#include "Point.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <map>
+
+// Writes results & lattice snapshots to files on a separate thread, so that the threads doing the simulations never wait for the disk.
+// Simulation threads copy what they want written into a batch, and push it onto a bounded lock-free queue.
+// If the queue is full, or a batch is capacity or more sequence numbers ahead of the next one to be written, the pushing thread waits (backpressure),
+// so at most capacity batches are ever held. It never waits for a file.
+//
+// A writer thread takes the batches off the queue, puts them back in order of their sequence numbers, and formats each into one of
+// 2 buffers. A flusher thread writes the other buffer to disk at the same time, so formatting & writing overlap.
+// The files are written in sequence order, whichever order the batches were pushed in. Sequence numbers must go 0, 1, 2, ... without gaps;
+// the overloads without a sequence number hand them out in the order they're called, which is deterministic for a single producer.
+// If there are gaps anyway, wait() & the destructor write what's held in order, skipping the missing numbers. But a batch capacity or more
+// past a gap waits for the missing number like any other, so it can only be pushed once that's been skipped.
+// Nothing writes through the queue unless it's asked to: F_calculation_to_file & print_lattice_to_file are still synchronous.
+// The formats are the same as F_calculation_to_file & print_lattice_to_file.
+
+const int RESULTS_BATCH = 0; // A list of numbers, 1 per line
+const int SNAPSHOT_BATCH = 1; // A lattice of labels, 1 row per line
+
+struct OutputBatch {
+	long long sequence; // Position of this batch in the output
+	int kind; // RESULTS_BATCH or SNAPSHOT_BATCH
+	std::string filename;
+	bool append; // Append to the file instead of replacing it
+	std::vector<double> data; // RESULTS_BATCH
+	std::vector<int> lattice; // SNAPSHOT_BATCH, size*size labels, row by row
+	int size; // SNAPSHOT_BATCH
+};
+
+class OutputQueue
+{
+private:
+
+	struct Cell {
+		std::atomic<long long> turn; // Which lap of the ring the cell is ready for.
+		OutputBatch* batch;
+	};
+
+	int capacity; // Number of cells in the ring. A power of 2.
+	Cell* cells;
+	std::atomic<long long> push_position; // Next cell to push into. Shared by every producer.
+	std::atomic<long long> pop_position; // Next cell to pop from. Only the writer thread uses it.
+	std::atomic<long long> next_auto_sequence; // For the overloads without a sequence number.
+	std::atomic<long long> next_sequence; // Next sequence number the writer will format. Only the writer thread changes it.
+	std::atomic<int> n_waiting; // Threads in wait(). While there are any, the writer doesn't hold batches back for missing sequence numbers.
+	std::atomic<long long> n_pushed; // Batches pushed so far.
+	std::atomic<long long> n_written; // Batches written to disk so far.
+	std::atomic<bool> stopping; // Set by the destructor once nothing else will be pushed.
+	std::atomic<int> failures; // Files that couldn't be written.
+
+	// Double buffering between the writer & flusher threads.
+	struct Buffer {
+		std::string text;
+		std::string filename;
+		bool append;
+		int n_batches; // Batches formatted into this buffer.
+		bool full; // Waiting to be written by the flusher.
+	};
+	Buffer buffers[2];
+	int active; // Buffer the writer is formatting into.
+	std::mutex buffer_mutex;
+	std::condition_variable buffer_ready; // Flusher waits on this for a full buffer.
+	std::condition_variable buffer_free; // Writer waits on this for an empty buffer.
+	bool flusher_done; // Set by the writer when it won't fill any more buffers.
+
+	std::thread writer;
+	std::thread flusher;
+
+	bool try_pop(OutputBatch*& batch); // Takes the next batch off the ring, if there is one.
+	void push(OutputBatch* batch); // Puts a batch on the ring, waiting for a free cell if it's full, or for the writer to catch up if the batch is too far ahead.
+	void write_loop(); // The writer thread.
+	void format_pending(std::map<long long, OutputBatch*>& pending, bool skip_gaps); // Formats the held batches that are next in line, or all of them if skip_gaps.
+	void flush_loop(); // The flusher thread.
+	void format(OutputBatch* batch); // Formats a batch into the active buffer, handing buffers over to the flusher as needed.
+	void hand_over(); // Gives the active buffer to the flusher, and switches to the other one.
+public:
+	OutputQueue(int capacity = 64); // Starts the writer & flusher threads. capacity is rounded up to a power of 2.
+	~OutputQueue(); // Writes everything still queued, then stops the threads.
+
+	void results(long long sequence, const char* filename, double* data, int n, bool append = false); // Queues the array "data" of size "n" to be written to filename.
+	void results(const char* filename, double* data, int n, bool append = false); // Same, with the next automatic sequence number.
+	void snapshot(long long sequence, const char* filename, int L[MAX_SIZE][MAX_SIZE], int size, bool append = false); // Queues a copy of the lattice to be written to filename.
+	void snapshot(const char* filename, int L[MAX_SIZE][MAX_SIZE], int size, bool append = false); // Same, with the next automatic sequence number.
+
+	void wait(); // Waits until everything pushed so far is on disk. Everything before it in sequence must have been pushed.
+	int get_failures(); // Number of files that couldn't be written.
+};
@@ -1,7 +1,12 @@
 #include "Point.h"
+#include "Observables.h"
+#include "Instrumentation.h"
+#include "Workspace.h"
+#include "FixedLattice.h"
 #include <iostream>
 #include <iomanip>
 #include <stack>
+#include <algorithm>
 #include <random>
 #include <fstream>
 
@@ -57,8 +62,28 @@ void Point::report() {
 }
 
 
+bool randreal(mt19937 &mt_rand, double p) {
+	/*Returns true with probability p.*/
+	
+	// Sanity check: p in range [0,1], as is necessary for a probability.
+	if (p<0 || p>1) {
+		cout << "ERROR: p must be a double in the range [0,1]" << endl;
+		return false;
+	}
+	
+	uniform_real_distribution<double> mint(0, 1);
+
+	if (mint(mt_rand) <= p) return true;
+	else return false;
+}
+
+
+
 void rewrite_labels(int* cluster_labels, int old_label, int new_label) {
+	// Both labels must be proper labels. The entry of a proper label holds the size of its cluster, so the sizes are added first.
+	cluster_labels[new_label] += cluster_labels[old_label];
 	cluster_labels[old_label] = -new_label; //Changes old_label into a reference to show it's no longer a proper label.
+	INSTRUMENT_COUNT(UNIONS, 1);
 }
 
 
@@ -174,7 +199,7 @@ void print_lattice(Point L[MAX_SIZE][MAX_SIZE], int size) {
 
 int find_proper_label(int* cluster_labels, int c) {
 	/* c is the cluster of which we need to find the proper label. 
-		It iterates through the list until positive number (signifying the proper label) is found.
+		It iterates through the list until a non-negative number (signifying the proper label, and holding the size of its cluster) is found.
 		Furthermore, the function optimises cluster_labels at the end of each call, by making all entries it viewed into a "most direct reference".
 	*/
 	/* Assumptions & Errors:
@@ -211,12 +236,36 @@ int find_proper_label(int* cluster_labels, int c) {
 
 	delete[] a; // Drop dynamic memory
 
+	INSTRUMENT_COUNT(FIND_PROPER_LABEL_CALLS, 1);
+	INSTRUMENT_COUNT(FIND_PROPER_LABEL_STEPS, i);
+
 	return c; // Return proper label
 
 }
 
 
 
+int merge_clusters(int* cluster_labels, int a, int b) {
+	/* Links the clusters containing assigned labels a & b, for when a bond or site joins them.
+		The smaller proper label is kept, so that the proper label of a cluster is always the minimum label in it.
+	*/
+
+	a = find_proper_label(cluster_labels, a);
+	b = find_proper_label(cluster_labels, b);
+
+	if (a == b) return a; // Already the same cluster.
+
+	if (a < b) {
+		rewrite_labels(cluster_labels, b, a);
+		return a;
+	}
+
+	rewrite_labels(cluster_labels, a, b);
+	return b;
+}
+
+
+
 int find_spanning_cluster(Point L[MAX_SIZE][MAX_SIZE], int size, int* cluster_labels) {
 	/*Checks the 4 edges for clusters.
 	If a cluster is present on al 4 edges, return cluster label.
@@ -235,6 +284,9 @@ int find_spanning_cluster(Point L[MAX_SIZE][MAX_SIZE], int size, int* cluster_la
 	int* right_edge = new int[size]; // Right edge
 	int n_right_edge = 0;
 
+	INSTRUMENT_COUNT(SPANNING_CHECKS, 1);
+	INSTRUMENT_COUNT(EDGE_SITES_SCANNED, 4 * size);
+
 	// Collect all non-zero clusters into the lists.
 	for (int i = 0; i < size; i++) {
 
@@ -337,11 +389,13 @@ double mean(double* data, int size) {
 bool F_calculation_to_file(const char* filename, double* data, int n) {
 	/*Create a csv file and put data from "data" into it, delimited by newlines.*/
 
+	INSTRUMENT_PHASE_BEGIN(PHASE_WRITE);
 	ofstream outfile(filename, ios::out); // Create output file.
 
 	// Defensive programming: If I cant make file. IMPORTANT  MAY BE DENIED PERMISSION.
 	if (!outfile) {
 		cout << "Failed to create file" << endl;
+		INSTRUMENT_PHASE_END(PHASE_WRITE);
 		return EXIT_FAILURE;
 	}
 
@@ -351,9 +405,113 @@ bool F_calculation_to_file(const char* filename, double* data, int n) {
 		if (i < n - 1)  outfile << endl;  // Add a newline character, unless we're on the last entry.
 	}
 
+	INSTRUMENT_COUNT(BYTES_WRITTEN, (long long)outfile.tellp());
 	outfile.close(); // Close the file
+	INSTRUMENT_PHASE_END(PHASE_WRITE);
 
 	return EXIT_SUCCESS;
 }
 
 
+
+double F_calculation(const int size, const double p, mt19937 &mt_rand) {
+	/*This creates 1 lattice with occupation probability p, calculates F for the spanning cluster in that lattice, and returns it.*/
+
+	Point L[MAX_SIZE][MAX_SIZE]; // Initialise lattice of points.
+	initialise_lattice(L, size); // Initialise lattice as described in "initialise_lattice".
+
+	int cluster_ID = 1; // Holds the value of the highest cluster not yet initialised.
+	int spanning_cluster = 0; // Label for spanning cluster
+
+	int* cluster_labels = new int[size*size + 1]; // Max number of labels in a lattice = size*size + 1. Why? It needs a place for 0, and a space for each element in the lattice.
+	for (int i = 0; i < size*size + 1; i++) cluster_labels[i] = 1; // Initialise cluster_labels, making each assigned label a proper label of a cluster of 1 site.
+	cluster_labels[0] = 0; // 0 is unoccupied.
+
+	// Make lattice of occuptation probability p. 
+	INSTRUMENT_PHASE_BEGIN(PHASE_GENERATE);
+	for (int i = 0; i < size; i++) { // Every element in row i
+
+		for (int j = 0; j < size; j++) {
+
+			// Makes a new cluster with probability p.
+			if (randreal(mt_rand, p)) {
+				L[i][j].set_val(cluster_ID);
+				cluster_ID++;
+			}
+
+		}
+	}
+
+	INSTRUMENT_PHASE_END(PHASE_GENERATE);
+
+	// Do bfs on each element to do the cluster-relabeling algorithm.
+	// This loop leverages the invariant that every subsequent element is either zero, or has a value greater than the value of the current element.
+	// This way, the property that the proper label of a cluster is the minimum cluster label found in that cluster is preserved.
+	INSTRUMENT_PHASE_BEGIN(PHASE_LABEL);
+	for (int i = 0; i < size; i++) {
+
+		for (int j = 0; j < size; j++) {
+
+			// If a nonzero element still has not been explored, then explore it & its neighbours, and link them together under 1 proper label.
+			if (L[i][j].get_val() != 0 && L[i][j].get_colour() == 'w') {
+				bfs(L, size, L[i][j], cluster_labels);
+			}
+
+		}
+	}
+
+	INSTRUMENT_PHASE_END(PHASE_LABEL);
+
+	// Get the spanning cluster
+	INSTRUMENT_PHASE_BEGIN(PHASE_MEASURE);
+	spanning_cluster = find_spanning_cluster(L, size, cluster_labels);
+
+	//Error handling if no spanning cluster was made.
+	if (spanning_cluster == 0) {
+		//cout << "ERROR: No spanning cluster made with probability " << p << " in lattice." << endl;
+		INSTRUMENT_PHASE_END(PHASE_MEASURE);
+		delete[] cluster_labels;
+		return -1;
+	}
+
+
+	//Calculate F. F = sites in spanning cluster / occupied sites.
+	// The cluster sizes are kept in cluster_labels, so this is one pass over the labels rather than the lattice.
+	FObserver F;
+	ObservablePipeline pipeline;
+	pipeline.add(&F);
+	pipeline.run(cluster_labels, cluster_ID, spanning_cluster, size*size);
+	INSTRUMENT_PHASE_END(PHASE_MEASURE);
+
+	// Drop dynamic memory.
+	delete[] cluster_labels;
+
+	// Return F.
+	return F.get_F();
+}
+
+
+
+void ensemble_F(double* data, int size, double p, int nens, mt19937 &mt_rand) {
+	/* Do nens lattice simulations, and store their Fs into an array called data.
+		Sizes with compiled kernels use those. Otherwise every lattice reuses the same workspace, so nothing is allocated or cleared per lattice. */
+
+	if (fixed_ensemble_F(data, size, p, nens, mt_rand)) return;
+
+	int i = 0;
+	double val;
+	Workspace W(size, SITE_MODE);
+
+	// Keep on iterating until we have nens values of F.
+	while (i < nens) {
+		val = F_calculation(W, p, mt_rand);
+		if (val > 0) { //If a spanning cluster has been gotten in this particular case.
+			data[i] = val; //Save the associated F
+			i++;
+		}
+		else INSTRUMENT_COUNT(REJECTED_LATTICES, 1);
+		INSTRUMENT_POLL();
+
+	}
+
+}
@@ -25,18 +25,26 @@ public:
 	void report(); // Prints out position, cluster label, and colour 
 };
 
+bool randreal(std::mt19937 &mt_rand, double p); // Returns true with probability p.
+
 void bfs(Point L[MAX_SIZE][MAX_SIZE], const int size, Point start_node, int* cluster_labels); // Do Breadth-first search on lattice that already has a cluster label assigned to each element, but hasn't created a cluster_list yet.
 
 void initialise_lattice(Point L[MAX_SIZE][MAX_SIZE], int size); //Fill lattice L with points of colour 'w', label 0, and {x,y} their positions in the lattice.
 
 void print_lattice(Point L[MAX_SIZE][MAX_SIZE], int size); // Prints the lattice the stdout.
 
-void rewrite_labels(int* cluster_labels, int old_label, int new_label); // Links 2 clusters by changing the proper label of cluster with label "old_label" to "new_label"
+void rewrite_labels(int* cluster_labels, int old_label, int new_label); // Links 2 clusters by changing the proper label of cluster with label "old_label" to "new_label", and adds its size to "new_label".
 
 int find_spanning_cluster(Point L[MAX_SIZE][MAX_SIZE], int size, int* cluster_labels); // Finds the spanning cluster of the lattice, and outputs the cluster label. Outputs 0 otherwise.
 
 int find_proper_label(int* cluster_labels, int c); // Gets the proper label of a cluster.
 
+int merge_clusters(int* cluster_labels, int a, int b); // Joins the clusters containing labels a & b under the smaller proper label, and returns it.
+
 double mean(double* data, int size); // Gets the mean of an array of data of size "size".
 
 bool F_calculation_to_file(const char* filename, double* data, int n); // Basically outputs all the data in the array "data" of size "n" to given filename, delimited by newlines.
+
+double F_calculation(const int size, const double p, std::mt19937 &mt_rand); // Creates 1 lattice with occupation probability p, and returns F for its spanning cluster, or -1 if there isn't one.
+
+void ensemble_F(double* data, int size, double p, int nens, std::mt19937 &mt_rand); // Stores nens values of F into data, ignoring lattices without a spanning cluster.
@@ -0,0 +1,155 @@
+#include "RareEvent.h"
+#include "Lattice.h"
+#include "Instrumentation.h"
+#include <iostream>
+#include <random>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+
+int spanning_sweep(Workspace &W, int* order, double* F, mt19937 &mt_rand) {
+	/* The same way of adding sites as generate_lattice(Workspace&), but the order is a Fisher-Yates shuffle made as it goes, so it never
+		has to look for an unoccupied site, and it carries on after spanning to the full lattice. The spanning cluster only grows after that,
+		so its size is read from the root of its label after every site. */
+
+	W.reset();
+	int size = W.get_size();
+	int n_sites = size*size;
+
+	for (int k = 0; k < n_sites; k++) order[k] = k;
+
+	int x, y, j, site;
+	int neighbours[N_NEIGHBOURS]; // Proper labels of the neighbouring clusters.
+	int n_neighbours;
+	int label;
+	int spanning_label = 0;
+	int n_spanning = 0; // Occupied sites when it first spans.
+
+	INSTRUMENT_PHASE_BEGIN(PHASE_GENERATE);
+	for (int n = 1; n <= n_sites; n++) {
+
+		// Pick the next site at random from the ones not yet occupied.
+		j = n - 1 + random(mt_rand, n_sites - (n - 1));
+		swap(order[n - 1], order[j]);
+		site = order[n - 1];
+		x = site / size;
+		y = site % size;
+
+		n_neighbours = 0;
+		if (x != 0 && W.get_site(x - 1, y) != 0) neighbours[n_neighbours++] = W.find(W.get_site(x - 1, y));
+		if (x != size - 1 && W.get_site(x + 1, y) != 0) neighbours[n_neighbours++] = W.find(W.get_site(x + 1, y));
+		if (y != 0 && W.get_site(x, y - 1) != 0) neighbours[n_neighbours++] = W.find(W.get_site(x, y - 1));
+		if (y != size - 1 && W.get_site(x, y + 1) != 0) neighbours[n_neighbours++] = W.find(W.get_site(x, y + 1));
+
+		if (n_neighbours == 0) { // It's a new cluster
+			label = W.new_label(x, y);
+			W.set_site(x, y, label);
+		}
+		else { // Join the cluster with the smallest label, then merge the rest into it.
+			label = *min_element(neighbours, neighbours + n_neighbours);
+			W.set_site(x, y, label);
+			W.add_site(label, x, y);
+			for (int i = 0; i < n_neighbours; i++) label = W.merge(label, neighbours[i]);
+		}
+
+		if (spanning_label == 0 && W.cluster_edges(label) == ALL_EDGES) { // Spanning cluster found.
+			spanning_label = label;
+			n_spanning = n;
+		}
+		if (spanning_label != 0) F[n] = (double)W.cluster_size(W.find(spanning_label)) / n;
+	}
+	INSTRUMENT_PHASE_END(PHASE_GENERATE);
+
+	return n_spanning;
+}
+
+void binomial_weights(int n_sites, double p, double* B) {
+	/* Done with logs, as p^n (1-p)^(N-n) underflows long before the binomial coefficients overflow. */
+
+	for (int n = 0; n <= n_sites; n++) {
+		if (p <= 0) B[n] = n == 0 ? 1 : 0;
+		else if (p >= 1) B[n] = n == n_sites ? 1 : 0;
+		else B[n] = exp(lgamma(n_sites + 1.0) - lgamma(n + 1.0) - lgamma(n_sites - n + 1.0) + n*log(p) + (n_sites - n)*log(1 - p));
+	}
+}
+
+
+
+void rare_ensemble_F(double* data, double* weights, int size, double p, int nens, mt19937 &mt_rand) {
+	/* Do nens sweeps, and store the F & weight of each at p. Every sweep reuses the same workspace & arrays. */
+
+	if (p < 0 || p > 1) {
+		cout << "ERROR: p must be a double in the range [0,1]" << endl;
+		return;
+	}
+
+	int n_sites = size*size;
+	Workspace W(size, SITE_MODE);
+	int* order = new int[n_sites];
+	double* F = new double[n_sites + 1];
+	double* B = new double[n_sites + 1];
+	binomial_weights(n_sites, p, B);
+
+	int n_spanning;
+	double weight, total;
+
+	for (int i = 0; i < nens; i++) {
+		n_spanning = spanning_sweep(W, order, F, mt_rand);
+
+		INSTRUMENT_PHASE_BEGIN(PHASE_MEASURE);
+		weight = 0;
+		total = 0;
+		for (int n = n_spanning; n <= n_sites; n++) {
+			weight += B[n];
+			total += B[n] * F[n];
+		}
+		INSTRUMENT_PHASE_END(PHASE_MEASURE);
+
+		weights[i] = weight;
+		data[i] = weight > 0 ? total / weight : -1;
+		if (weight == 0) INSTRUMENT_COUNT(REJECTED_LATTICES, 1);
+		INSTRUMENT_POLL();
+	}
+
+	delete[] order;
+	delete[] F;
+	delete[] B;
+}
+
+RareEventResult rare_event_estimate(double* data, double* weights, int nens) {
+	/* P is the mean weight, with the usual standard error.
+		F is a ratio of 2 means, so its error is the linearised (delta method) error of a weighted mean: sum of w^2 (F - mean)^2, over (sum of w)^2. */
+
+	RareEventResult result = { 0, 0, -1, 0, 0 };
+	if (nens < 2) {
+		cout << "ERROR: Need at least 2 sweeps for an error estimate" << endl;
+		return result;
+	}
+
+	double sum_w = 0, sum_w2 = 0, sum_wF = 0;
+	for (int i = 0; i < nens; i++) {
+		sum_w += weights[i];
+		sum_w2 += weights[i] * weights[i];
+		if (weights[i] > 0) sum_wF += weights[i] * data[i];
+	}
+
+	result.P = sum_w / nens;
+	result.P_error = sqrt(max(0.0, (sum_w2 / nens - result.P*result.P) / (nens - 1)));
+
+	if (sum_w == 0) {
+		cout << "ERROR: No sweep can span at this p" << endl;
+		return result;
+	}
+
+	result.F = sum_wF / sum_w;
+	double spread = 0;
+	for (int i = 0; i < nens; i++) {
+		if (weights[i] > 0) spread += weights[i] * weights[i] * (data[i] - result.F) * (data[i] - result.F);
+	}
+	result.F_error = sqrt(spread * nens / (nens - 1)) / sum_w;
+	result.effective_samples = sum_w*sum_w / sum_w2;
+
+	return result;
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include "Workspace.h"
+#include <random>
+
+// F & the spanning probability at p well below pc, where ensemble_F would throw away almost every lattice.
+// Instead of a lattice of occupation probability p, each realization is a Newman-Ziff sweep: all the sites are occupied one at a time in a random order,
+// which gives a lattice for every number of occupied sites n at once. Spanning can't be undone, so the sweep spans from some n_c on, and
+// F is known for every n >= n_c. A lattice of occupation probability p has n occupied sites with the binomial probability B(n), so a sweep
+// stands for all of them: it spans at p with weight sum_{n >= n_c} B(n), and its F at p is sum_{n >= n_c} B(n) F(n) / weight.
+// No sweep is thrown away, and the binomial tail is summed exactly instead of being sampled.
+//
+// The weighted mean of the Fs is the mean F of the lattices that span, and the mean weight is the spanning probability.
+// Far below pc, the weights are dominated by the few sweeps that span early, so the error estimates matter: they come from rare_event_estimate.
+
+struct RareEventResult {
+	double P; // Spanning probability.
+	double P_error; // Standard error of P.
+	double F; // Mean F of the lattices that span.
+	double F_error; // Standard error of F.
+	double effective_samples; // (sum of weights)^2 / sum of weights^2. Much less than nens means a few sweeps dominate.
+};
+
+int spanning_sweep(Workspace &W, int* order, double* F, std::mt19937 &mt_rand); // Occupies every site in a random order, and returns the number of occupied sites when it first spans. F[n] = F with n sites occupied, for n from then to size*size. order is size*size sites of scratch.
+
+void binomial_weights(int n_sites, double p, double* B); // B[n] = probability of n occupied sites out of n_sites, for n = 0 ... n_sites.
+
+void rare_ensemble_F(double* data, double* weights, int size, double p, int nens, std::mt19937 &mt_rand); // Does nens sweeps, and stores their Fs at p into data & their weights into weights. Weight 0 means the sweep can't span at p, and then data is -1.
+
+RareEventResult rare_event_estimate(double* data, double* weights, int nens); // Spanning probability & mean F, with their errors, from the output of rare_ensemble_F.
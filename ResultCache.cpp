@@ -0,0 +1,228 @@
+#include "ResultCache.h"
+#include "Point.h"
+#include "Lattice.h"
+#include "Bond.h"
+#include "Instrumentation.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+#include <filesystem>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+
+void Accumulator::add(double x) {
+	count++;
+	sum += x;
+	sum_sq += x*x;
+}
+
+void Accumulator::merge(const Accumulator &other) {
+	count += other.count;
+	sum += other.sum;
+	sum_sq += other.sum_sq;
+}
+
+double Accumulator::mean() {
+	return count > 0 ? sum / count : 0;
+}
+
+double Accumulator::error() {
+	/* Standard error from the sample variance. */
+
+	if (count < 2) return 0;
+	double m = mean();
+	return sqrt(max(0.0, (sum_sq / count - m*m) / (count - 1)));
+}
+
+
+
+string CacheKey::text() const {
+	/* p is written with all 17 digits, so 2 keys only match if their ps are the same double. */
+
+	const char* kinds[] = { "site_F", "bond_F", "site_pc", "bond_pc" };
+	ostringstream out;
+	out << kinds[kind] << " size=" << size << " p=" << setprecision(17) << p << " first=" << first << " n=" << n
+		<< " seed=" << seed << " version=" << PERCOLATION_CODE_VERSION;
+	return out.str();
+}
+
+unsigned long long CacheKey::hash() const {
+	string t = text();
+	unsigned long long h = 14695981039346656037ULL; // FNV offset basis
+	for (size_t i = 0; i < t.size(); i++) {
+		h ^= (unsigned char)t[i];
+		h *= 1099511628211ULL; // FNV prime
+	}
+	return h;
+}
+
+
+
+ResultCache::ResultCache(const char* directory) : directory(directory), hits(0), misses(0) {
+	error_code ec;
+	filesystem::create_directories(directory, ec);
+	if (ec) cout << "ERROR: Can't create cache directory " << directory << endl;
+}
+
+string ResultCache::path(const CacheKey &key) {
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.txt", key.hash());
+	return (filesystem::path(directory) / name).string();
+}
+
+bool ResultCache::load(const CacheKey &key, Accumulator &result, mt19937* generator) {
+	/* An entry is the key on the first line, then count, sum & sum of squares on the second,
+		then for a part-filled chunk, the state of its generator. Anything else is a miss. */
+
+	ifstream infile(path(key));
+	string line;
+	if (!infile || !getline(infile, line) || line != key.text() || !(infile >> result.count >> result.sum >> result.sum_sq) ||
+		(generator != NULL && result.count < key.n && !(infile >> *generator))) {
+		misses++;
+		return false;
+	}
+	hits++;
+	return true;
+}
+
+bool ResultCache::store(const CacheKey &key, const Accumulator &result, const mt19937* generator) {
+	/* Written to a temporary file first & then renamed, so a sweep that's killed part way never leaves half an entry behind.
+		The temporary file is named after the process too, so 2 sweeps sharing the cache never write into the same one. */
+
+	INSTRUMENT_PHASE_BEGIN(PHASE_WRITE);
+	string final_path = path(key);
+	string temporary = final_path + "." + to_string((long long)getpid()) + ".tmp";
+	ofstream outfile(temporary, ios::out);
+	if (!outfile) {
+		cout << "Failed to create file" << endl;
+		INSTRUMENT_PHASE_END(PHASE_WRITE);
+		return false;
+	}
+	outfile << key.text() << endl;
+	outfile << result.count << " " << setprecision(17) << result.sum << " " << result.sum_sq << endl;
+	if (generator != NULL && result.count < key.n) outfile << *generator << endl; // Full chunks never carry on, so they don't need it.
+	INSTRUMENT_COUNT(BYTES_WRITTEN, (long long)outfile.tellp());
+	outfile.close();
+
+	error_code ec;
+	if (!outfile) { // Eg. the disk is full. Don't let a partial entry replace a good one.
+		filesystem::remove(temporary, ec);
+		INSTRUMENT_PHASE_END(PHASE_WRITE);
+		cout << "Failed to write file" << endl;
+		return false;
+	}
+
+	filesystem::rename(temporary, final_path, ec);
+	INSTRUMENT_PHASE_END(PHASE_WRITE);
+	if (ec) {
+		cout << "Failed to create file" << endl;
+		filesystem::remove(temporary, ec);
+		return false;
+	}
+	return true;
+}
+
+int ResultCache::get_hits() {
+	return hits;
+}
+
+int ResultCache::get_misses() {
+	return misses;
+}
+
+
+
+mt19937 chunk_generator(const CacheKey &key) {
+	/* The generator only depends on the seed & the first realization, so the same chunk always gives the same results,
+		and a shorter last chunk gives the first realizations of the full one. Every p & size uses the same generators. */
+
+	seed_seq seeds = { key.seed, (unsigned int)(key.first >> 32), (unsigned int)key.first };
+	return mt19937(seeds);
+}
+
+void extend_chunk(const CacheKey &key, int n, Accumulator &result, mt19937 &mt_rand) {
+	/* The values are added in the order they're made, so a chunk built up in several goes has exactly the sums of one made in 1. */
+
+	if (n <= 0) return;
+	double* data = new double[n];
+	switch (key.kind) {
+	case SITE_F_ENSEMBLE: ensemble_F(data, key.size, key.p, n, mt_rand); break;
+	case BOND_F_ENSEMBLE: ensemble_bond_F(data, key.size, key.p, n, mt_rand); break;
+	case SITE_PC_ENSEMBLE: ensemble_lattice(data, key.size, n, mt_rand); break;
+	case BOND_PC_ENSEMBLE: ensemble_bond_lattice(data, key.size, n, mt_rand); break;
+	}
+
+	for (int i = 0; i < n; i++) result.add(data[i]);
+	delete[] data;
+}
+
+Accumulator compute_chunk(const CacheKey &key) {
+	mt19937 mt_rand = chunk_generator(key);
+	Accumulator result = { 0, 0, 0 };
+	extend_chunk(key, key.n, result, mt_rand);
+	return result;
+}
+
+Accumulator cached_ensemble(ResultCache &cache, int kind, int size, double p, int nens, unsigned int seed, int chunk) {
+	/* Chunk c covers realizations [c*chunk, (c+1)*chunk), and the last one stops at nens.
+		A stored chunk with fewer realizations than wanted is carried on from its generator, & stored again.
+		One with more is left alone for the sweeps that want them, and the realizations wanted are computed from the start. */
+
+	Accumulator total = { 0, 0, 0 };
+	if (kind < SITE_F_ENSEMBLE || kind > BOND_PC_ENSEMBLE) {
+		cout << "ERROR: Unknown kind of ensemble" << endl;
+		return total;
+	}
+	if (chunk < 1) {
+		cout << "ERROR: Chunks must have at least 1 realization" << endl;
+		return total;
+	}
+	if (kind == SITE_PC_ENSEMBLE || kind == BOND_PC_ENSEMBLE) p = 0; // So every p shares the same entries.
+
+	bool resumable = kind != BOND_PC_ENSEMBLE; // See ResultCache.h
+	CacheKey key = { kind, size, p, 0, chunk, seed };
+	Accumulator part;
+	mt19937 mt_rand;
+	int wanted;
+	bool found;
+	for (long long first = 0; first < nens; first += chunk) {
+		key.first = first;
+		wanted = (int)min<long long>(chunk, nens - first);
+		found = cache.load(key, part, resumable ? &mt_rand : NULL);
+
+		if (!found || part.count > wanted || (part.count < wanted && !resumable)) {
+			mt_rand = chunk_generator(key);
+			Accumulator fresh = { 0, 0, 0 };
+			extend_chunk(key, wanted, fresh, mt_rand);
+			if (!found || fresh.count > part.count) cache.store(key, fresh, resumable ? &mt_rand : NULL);
+			part = fresh;
+		}
+		else if (part.count < wanted) {
+			extend_chunk(key, wanted - (int)part.count, part, mt_rand);
+			cache.store(key, part, &mt_rand);
+		}
+		total.merge(part);
+		INSTRUMENT_POLL();
+	}
+	return total;
+}
+
+void cached_sweep(ResultCache &cache, int kind, int size, double* p, int n_p, int nens, unsigned int seed, double* means, double* errors) {
+	for (int i = 0; i < n_p; i++) {
+		Accumulator a = cached_ensemble(cache, kind, size, p[i], nens, seed);
+		means[i] = a.mean();
+		errors[i] = a.error();
+	}
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <random>
+#include <string>
+
+// Finished ensembles kept on disk, so a sweep that repeats or extends an earlier one only computes what's new.
+// An ensemble is split into chunks of realizations, and each chunk is always computed with its own generator, seeded from the seed & the chunk's first realization.
+// So a chunk's results only depend on its key: the kind of ensemble, size, p, which realizations it covers, the seed and the code version.
+// Each chunk is stored as a count, sum & sum of squares, in a file named after the FNV-1a hash of its key. The key is written into the file too,
+// and checked on loading, so a hash collision is just a miss.
+//
+// A sweep of nens realizations at some (kind, size, p, seed) loads every chunk that's already there, computes & stores the rest, and merges them.
+// Doubling nens only computes the new chunks. If nens isn't a whole number of chunks, the last chunk is stored part-filled, with the state of its
+// generator, so a later sweep with a bigger nens carries on from where it stopped. Running realizations in 2 goes gives the same results as in 1,
+// except for BOND_PC_ENSEMBLE, whose workspace keeps the order of the bonds from one lattice to the next: its part-filled chunks are all-or-nothing,
+// and are computed again from the start when more of them is needed.
+
+// The code version comes from the build, e.g. -DPERCOLATION_CODE_VERSION="\"$(git rev-parse HEAD)\"", so entries stop matching when the code changes
+// without anyone having to remember to change it. Without it, the time the cache was compiled is used, so entries are only reused by the same build.
+#ifndef PERCOLATION_CODE_VERSION
+#define PERCOLATION_CODE_VERSION "built " __DATE__ " " __TIME__
+#endif
+
+// Kinds of ensemble.
+const int SITE_F_ENSEMBLE = 0; // ensemble_F
+const int BOND_F_ENSEMBLE = 1; // ensemble_bond_F
+const int SITE_PC_ENSEMBLE = 2; // ensemble_lattice. p is ignored.
+const int BOND_PC_ENSEMBLE = 3; // ensemble_bond_lattice. p is ignored.
+
+const int CACHE_CHUNK = 100; // Default number of realizations per chunk.
+
+struct Accumulator {
+	long long count; // Number of values.
+	double sum; // Sum of the values.
+	double sum_sq; // Sum of their squares.
+
+	void add(double x); // Adds 1 value.
+	void merge(const Accumulator &other); // Adds all of the values of another accumulator.
+	double mean(); // Mean of the values, or 0 if there are none.
+	double error(); // Standard error of the mean, or 0 if there are fewer than 2 values.
+};
+
+struct CacheKey {
+	int kind; // SITE_F_ENSEMBLE ...
+	int size;
+	double p;
+	long long first; // First realization of the chunk.
+	int n; // Number of realizations in a full chunk. The entry may hold fewer, if it's the last one.
+	unsigned int seed;
+
+	std::string text() const; // The whole key, including PERCOLATION_CODE_VERSION, as 1 line of text.
+	unsigned long long hash() const; // 64 bit FNV-1a of text().
+};
+
+class ResultCache
+{
+private:
+
+	std::string directory; // Where the entries are kept.
+	int hits; // Entries found by load.
+	int misses; // Entries load didn't find.
+
+	std::string path(const CacheKey &key); // File for a key.
+public:
+	ResultCache(const char* directory); // Creates the directory if it isn't there.
+	bool load(const CacheKey &key, Accumulator &result, std::mt19937* generator = NULL); // Reads the entry for key, and if generator isn't NULL & the chunk isn't full, the state its generator stopped at. Returns false if there isn't one.
+	bool store(const CacheKey &key, const Accumulator &result, const std::mt19937* generator = NULL); // Writes the entry for key, with the state of generator if it isn't NULL & the chunk isn't full. Returns false if it can't.
+	int get_hits(); // Entries found so far.
+	int get_misses(); // Entries not found so far, ie. chunks that had to be computed.
+};
+
+std::mt19937 chunk_generator(const CacheKey &key); // The generator a chunk starts from.
+
+void extend_chunk(const CacheKey &key, int n, Accumulator &result, std::mt19937 &mt_rand); // Runs n more realizations of a chunk, carrying on with mt_rand, and adds them to result.
+
+Accumulator compute_chunk(const CacheKey &key); // Runs all the realizations of 1 chunk, with the generator for that chunk.
+
+Accumulator cached_ensemble(ResultCache &cache, int kind, int size, double p, int nens, unsigned int seed, int chunk = CACHE_CHUNK); // Count, sum & sum of squares of nens realizations, computing only the chunks that aren't in the cache.
+
+void cached_sweep(ResultCache &cache, int kind, int size, double* p, int n_p, int nens, unsigned int seed, double* means, double* errors); // cached_ensemble at every p, with the means & their standard errors stored into means & errors.
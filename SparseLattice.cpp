@@ -0,0 +1,228 @@
+#include "SparseLattice.h"
+#include "Lattice.h"
+#include "Instrumentation.h"
+#include <iostream>
+#include <cmath>
+#include <climits>
+
+using namespace std;
+
+
+SparseLattice::SparseLattice(int size) : size(size), mask(0), shift(64), table_current(false) {
+	/* Sites are ints, so a lattice that's too big is made with size 0 instead, which generate & sparse_ensemble_F refuse. */
+
+	if (size < 0 || (long long)size*size > INT_MAX) {
+		cout << "ERROR: A sparse lattice must have fewer than 2^31 sites" << endl;
+		this->size = 0;
+	}
+}
+
+int SparseLattice::get_size() {
+	return size;
+}
+
+int SparseLattice::get_n_occupied() {
+	return (int)sites.size();
+}
+
+int SparseLattice::slot(int site) {
+	/* Fibonacci hashing: the top bits of site * 2^64/golden ratio, which spreads out consecutive sites. */
+
+	return (int)(((unsigned long long)site * 11400714819323198485ULL) >> shift);
+}
+
+void SparseLattice::build_table() {
+	/* Linear probing, at most half full. Each slot holds a site & its id side by side, so a probe is 1 cache line. */
+
+	int n_slots = 16;
+	while (n_slots < 2 * (int)sites.size()) n_slots *= 2;
+	table.assign(2 * n_slots, -1);
+	mask = n_slots - 1;
+	shift = 64;
+	for (int n = n_slots; n > 1; n /= 2) shift--;
+
+	int s;
+	for (int id = 0; id < (int)sites.size(); id++) {
+		s = slot(sites[id]);
+		while (table[2 * s] != -1) s = (s + 1) & mask;
+		table[2 * s] = sites[id];
+		table[2 * s + 1] = id;
+	}
+	table_current = true;
+}
+
+int SparseLattice::lookup(int site) {
+	if (!table_current) build_table();
+	int s = slot(site);
+	while (table[2 * s] != -1) {
+		if (table[2 * s] == site) return table[2 * s + 1];
+		s = (s + 1) & mask;
+	}
+	return -1;
+}
+
+void SparseLattice::clear() {
+	sites.clear();
+	cluster_labels.clear();
+	edges.clear();
+	table_current = false;
+}
+
+void SparseLattice::occupy(int x, int y) {
+	sites.push_back(x*size + y);
+	table_current = false;
+}
+
+void SparseLattice::generate(double p, mt19937 &mt_rand) {
+	/* The gap to the next occupied site is k with probability (1-p)^k p, which is floor(log(U) / log(1-p)) for U uniform in (0,1]. */
+
+	clear();
+	if (size == 0) {
+		cout << "ERROR: Sparse lattice has no sites" << endl;
+		return;
+	}
+	if (p <= 0) return;
+
+	long long n_sites = (long long)size*size;
+	uniform_real_distribution<double> unit(0, 1);
+	double log_q = log1p(-p); // Accurate for small p, where 1 - p rounds.
+	double gap;
+
+	INSTRUMENT_PHASE_BEGIN(PHASE_GENERATE);
+	long long site = -1;
+	while (true) {
+		double u = 1 - unit(mt_rand); // In (0,1]
+		gap = p >= 1 ? 0 : floor(log(u) / log_q);
+		if (!(gap < n_sites)) gap = (double)n_sites; // Anything past the end is the end, including inf for tiny p, and it has to fit in a long long.
+		site += 1 + (long long)gap;
+		if (site >= n_sites) break;
+		sites.push_back((int)site);
+	}
+	table_current = false;
+	INSTRUMENT_PHASE_END(PHASE_GENERATE);
+}
+
+void SparseLattice::label() {
+	/* The same as F_calculation(Workspace&): every site starts as a cluster of its own, then it's joined to its occupied neighbours to the left & above.
+		The sites are in increasing order, so the one to the left can only be the id before, and the one above is found by a second id that
+		only ever moves forward, size sites behind. So labelling reads the sites once, in order, and never needs the hash table. */
+
+	int n = (int)sites.size();
+	cluster_labels.assign(n + 1, 1);
+	cluster_labels[0] = 0;
+	edges.assign(n + 1, 0);
+
+	INSTRUMENT_PHASE_BEGIN(PHASE_LABEL);
+	int x, y, a, b;
+	int above = 0; // First id that could be above the current site.
+	int neighbours[2];
+	int n_neighbours;
+	for (int id = 0; id < n; id++) {
+		x = sites[id] / size;
+		y = sites[id] % size;
+		edges[id + 1] = (unsigned char)edge_mask(x, y, size);
+
+		n_neighbours = 0;
+		if (y != 0 && id != 0 && sites[id - 1] == sites[id] - 1) neighbours[n_neighbours++] = id - 1;
+		if (x != 0) {
+			while (sites[above] < sites[id] - size) above++;
+			if (sites[above] == sites[id] - size) neighbours[n_neighbours++] = above;
+		}
+
+		for (int k = 0; k < n_neighbours; k++) {
+			// Join under the smaller proper label.
+			a = find(neighbours[k] + 1);
+			b = find(id + 1);
+			if (a == b) continue;
+			if (b < a) swap(a, b);
+			cluster_labels[a] += cluster_labels[b];
+			edges[a] |= edges[b];
+			cluster_labels[b] = -a;
+			INSTRUMENT_COUNT(UNIONS, 1);
+		}
+	}
+	INSTRUMENT_PHASE_END(PHASE_LABEL);
+}
+
+int SparseLattice::get_site(int x, int y) {
+	return lookup(x*size + y) + 1;
+}
+
+int SparseLattice::find(int c) {
+	INSTRUMENT_COUNT(FIND_PROPER_LABEL_CALLS, 1);
+	int root = c;
+	while (cluster_labels[root] < 0) root = -cluster_labels[root];
+	int next;
+	while (c != root) {
+		next = -cluster_labels[c];
+		cluster_labels[c] = -root;
+		c = next;
+	}
+	return root;
+}
+
+int SparseLattice::find_spanning_cluster() {
+	/* Every spanning cluster touches the top edge, and the top row is the first sites made, so only the ids up to the end of the top row need checking. */
+
+	INSTRUMENT_COUNT(SPANNING_CHECKS, 1);
+	int label;
+	for (int id = 0; id < (int)sites.size() && sites[id] < size; id++) {
+		label = find(id + 1);
+		if (edges[label] == ALL_EDGES) return label;
+	}
+	return 0;
+}
+
+int* SparseLattice::get_cluster_labels() {
+	return cluster_labels.data();
+}
+
+int SparseLattice::get_n_labels() {
+	return (int)cluster_labels.size();
+}
+
+void SparseLattice::measure(ObservablePipeline &pipeline) {
+	INSTRUMENT_PHASE_BEGIN(PHASE_MEASURE);
+	pipeline.run(get_cluster_labels(), get_n_labels(), find_spanning_cluster(), size*size);
+	INSTRUMENT_PHASE_END(PHASE_MEASURE);
+}
+
+
+
+double F_calculation(SparseLattice &S, const double p, mt19937 &mt_rand) {
+	if (p < 0 || p > 1) {
+		cout << "ERROR: p must be a double in the range [0,1]" << endl;
+		return -1;
+	}
+
+	S.generate(p, mt_rand);
+	S.label();
+
+	FObserver F;
+	ObservablePipeline pipeline;
+	pipeline.add(&F);
+	S.measure(pipeline);
+	return F.get_F();
+}
+
+void sparse_ensemble_F(double* data, int size, double p, int nens, mt19937 &mt_rand) {
+	/* Same as ensemble_F, ignoring lattices without a spanning cluster. */
+
+	SparseLattice S(size);
+	if (S.get_size() == 0) { // Too big, already reported. Nothing would ever span, so every entry is -1, as from F_calculation.
+		for (int j = 0; j < nens; j++) data[j] = -1;
+		return;
+	}
+	double F;
+	int i = 0;
+
+	while (i < nens) {
+		F = F_calculation(S, p, mt_rand);
+		if (F > 0) {
+			data[i] = F;
+			i++;
+		}
+		else INSTRUMENT_COUNT(REJECTED_LATTICES, 1);
+		INSTRUMENT_POLL();
+	}
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include "Observables.h"
+#include <random>
+#include <vector>
+
+// A size x size lattice that only stores its occupied sites, for small p, where the dense lattice & its size*size + 1 label table are nearly all empty.
+// Memory goes with the number of occupied sites instead of size*size, so lattices far bigger than MAX_SIZE fit, as long as size*size fits in an int.
+// A lattice any bigger is made with size 0, and reports an error instead of generating.
+//
+// Generating: the gaps between occupied sites are geometric, so each occupied site is found with 1 random number by skipping straight to it.
+// The lattices have the same distribution as F_calculation's, but aren't the same lattices for the same random numbers.
+// Occupied sites get compact ids in the order they're made, which is row by row, so the sites are a sorted list of x*size+y.
+// Labelling walks that list once, and never looks a site up. The open-addressing hash table is only for outside callers of get_site,
+// and is built the first time one asks.
+// Label id+1 is the assigned label of site id, and the labels are joined through cluster_labels exactly as everywhere else:
+// a negative entry references another label, and a proper label holds the size of its cluster. So the same observers work on it.
+
+class SparseLattice
+{
+private:
+
+	int size; // Length of each side of the lattice.
+	std::vector<int> sites; // x*size+y of each occupied site, by id.
+	std::vector<int> table; // Hash table of the occupied sites, as (site, id) pairs. -1 is an empty slot. Only built when get_site needs it.
+	int mask; // Number of slots - 1. The number of slots is a power of 2.
+	int shift; // 64 - log2 of the number of slots.
+	bool table_current; // Whether the table holds the sites there are now.
+	std::vector<int> cluster_labels; // Entry id+1 for site id. Entry 0 is unused.
+	std::vector<unsigned char> edges; // Edges touched by each cluster, while its label is proper.
+
+	int slot(int site); // First slot to look in for site.
+	void build_table(); // Puts every site in a new table.
+	int lookup(int site); // Id of site, or -1 if it isn't occupied.
+public:
+	SparseLattice(int size); // Empty lattice of this size.
+	int get_size(); // Length of each side of the lattice.
+	int get_n_occupied(); // Occupied sites.
+
+	void generate(double p, std::mt19937 &mt_rand); // Makes a new lattice of occupation probability p.
+	void occupy(int x, int y); // Occupies (x,y), for lattices made site by site. Sites must be occupied in increasing order of x*size+y.
+	void clear(); // Makes the lattice empty.
+	void label(); // Joins every occupied site to its occupied neighbours.
+
+	int get_site(int x, int y); // Assigned label of (x,y), or 0 if it's unoccupied.
+	int find(int c); // Proper label of label c, with path compression.
+	int find_spanning_cluster(); // Proper label of the cluster touching all 4 edges, or 0.
+	int* get_cluster_labels(); // The label table, for observers.
+	int get_n_labels(); // Labels are [1, get_n_labels()).
+	void measure(ObservablePipeline &pipeline); // Feeds every cluster to the pipeline.
+};
+
+double F_calculation(SparseLattice &S, const double p, std::mt19937 &mt_rand); // Same as F_calculation, on a sparse lattice. Returns -1 if nothing spans.
+
+void sparse_ensemble_F(double* data, int size, double p, int nens, std::mt19937 &mt_rand); // Same as ensemble_F, on a sparse lattice reused for the whole ensemble. Every entry is -1 if the lattice is too big.
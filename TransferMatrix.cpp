@@ -0,0 +1,319 @@
+#include "TransferMatrix.h"
+#include "Lattice.h"
+#include <iostream>
+#include <fstream>
+#include <cmath>
+
+using namespace std;
+
+
+// Edge flags of a frontier cluster. Bottom isn't needed: at the end, the frontier is the bottom row.
+const int TM_TOP = 1;
+const int TM_LEFT = 2;
+const int TM_RIGHT = 4;
+
+
+TransferMatrix::TransferMatrix(int width, int length) : width(width), length(length), n_sites(width*length), max_states(0), eval_p(NULL), n_eval(0) {
+	spanning_count = new double[n_sites + 1];
+	spanning_size = new double[n_sites + 1];
+	for (int n = 0; n <= n_sites; n++) {
+		spanning_count[n] = 0;
+		spanning_size[n] = 0;
+	}
+}
+
+TransferMatrix::~TransferMatrix() {
+	delete[] spanning_count;
+	delete[] spanning_size;
+}
+
+int TransferMatrix::get_width() {
+	return width;
+}
+
+int TransferMatrix::get_length() {
+	return length;
+}
+
+
+
+void TransferMatrix::StateTable::clear() {
+	index.clear();
+	states.clear();
+	offsets.clear();
+	sums.clear();
+}
+
+double* TransferMatrix::StateTable::find(const FrontierState& state, size_t length) {
+	auto inserted = index.emplace(state, (int)states.size());
+	if (inserted.second) {
+		states.push_back(state);
+		offsets.push_back(sums.size());
+		sums.resize(sums.size() + length, 0.0);
+	}
+	return &sums[offsets[inserted.first->second]];
+}
+
+void TransferMatrix::add_site(StateTable& from, StateTable& to, int x, int y) {
+	/* Each state has a vector of (1 + labels) blocks: the number of lattices that lead to it, then the total size of each label.
+		For the polynomials, a block has an entry for each n up to the sites added so far, and an occupied site moves each entry from n to n+1.
+		For evaluate(), a block has an entry for each p, and the site multiplies it by p or 1-p.
+		The site (x,y) replaces column y of the frontier. Its up neighbour is the old column y, and its left neighbour is column y-1.
+		After the change, the labels are renumbered in order of first appearance. Labels that are no longer on the frontier are dropped, as they can't reach the bottom. */
+
+	int n_max = x*width + y; // Sites added before this one, so the highest n so far.
+	int old_stride = eval_p == NULL ? n_max + 1 : n_eval;
+	int new_stride = eval_p == NULL ? n_max + 2 : n_eval;
+	int site_flags = (x == 0 ? TM_TOP : 0) | (y == 0 ? TM_LEFT : 0) | (y == width - 1 ? TM_RIGHT : 0);
+
+	int f[MAX_STRIP_WIDTH], g[MAX_STRIP_WIDTH]; // Frontier before & after, in old labels.
+	int flags[MAX_STRIP_WIDTH + 2]; // Flags of each old label.
+	int new_of_old[MAX_STRIP_WIDTH + 2]; // Renumbering, 0 if dropped.
+	int new_flags[MAX_STRIP_WIDTH + 2];
+	int n_old, n_new, up, left, label;
+	double* target;
+	const double* source;
+
+	for (size_t k = 0; k < from.states.size(); k++) {
+		const FrontierState& state = from.states[k];
+		const double* old = &from.sums[from.offsets[k]];
+
+		n_old = 0;
+		for (int i = 0; i < width; i++) {
+			f[i] = (int)((state.labels >> (4 * i)) & 15);
+			if (f[i] > n_old) n_old = f[i];
+		}
+		for (int l = 1; l <= n_old; l++) flags[l] = (int)((state.flags >> (3 * (l - 1))) & 7);
+
+		// 0: the site is unoccupied, 1: it's occupied.
+		for (int occupied = 0; occupied <= 1; occupied++) {
+
+			for (int i = 0; i < width; i++) g[i] = f[i];
+			label = 0;
+			up = f[y];
+			left = y > 0 ? f[y - 1] : 0;
+			if (occupied) {
+				if (up == 0 && left == 0) { // A new cluster
+					label = n_old + 1;
+					flags[label] = 0;
+				}
+				else if (up == 0 || left == 0 || up == left) label = up != 0 ? up : left;
+				else { // A bridge: left joins up.
+					label = up;
+					for (int i = 0; i < width; i++) if (g[i] == left) g[i] = up;
+				}
+			}
+			g[y] = label;
+
+			// Renumber in order of first appearance.
+			for (int l = 0; l <= n_old + 1; l++) new_of_old[l] = 0;
+			n_new = 0;
+			for (int i = 0; i < width; i++) {
+				if (g[i] != 0 && new_of_old[g[i]] == 0) new_of_old[g[i]] = ++n_new;
+			}
+			if (occupied && label == up && left != 0 && left != up) new_of_old[left] = new_of_old[up]; // The joined label adds to up.
+
+			for (int l = 1; l <= n_new; l++) new_flags[l] = 0;
+			for (int l = 1; l <= n_old; l++) {
+				if (new_of_old[l] != 0) new_flags[new_of_old[l]] |= flags[l];
+			}
+			if (occupied) new_flags[new_of_old[label]] |= site_flags;
+
+			FrontierState next = { 0, 0 };
+			for (int i = 0; i < width; i++) next.labels |= (unsigned long long)new_of_old[g[i]] << (4 * i);
+			for (int l = 1; l <= n_new; l++) next.flags |= (unsigned long long)new_flags[l] << (3 * (l - 1));
+
+			double* sums = to.find(next, (size_t)(1 + n_new) * new_stride);
+
+			// Block 0 is the count, and the site itself adds 1 to its cluster's size in every lattice, so that's moved twice.
+			for (int l = 0; l <= n_old; l++) {
+				if (l == 0) target = &sums[0];
+				else if (new_of_old[l] != 0) target = &sums[(size_t)new_of_old[l] * new_stride];
+				else continue;
+				source = &old[(size_t)l * old_stride];
+
+				if (eval_p == NULL) {
+					for (int n = 0; n <= n_max; n++) target[n + occupied] += source[n];
+					if (l == 0 && occupied) {
+						double* site_target = &sums[(size_t)new_of_old[label] * new_stride];
+						for (int n = 0; n <= n_max; n++) site_target[n + 1] += source[n];
+					}
+				}
+				else {
+					for (int j = 0; j < n_eval; j++) target[j] += source[j] * (occupied ? eval_p[j] : 1 - eval_p[j]);
+					if (l == 0 && occupied) {
+						double* site_target = &sums[(size_t)new_of_old[label] * new_stride];
+						for (int j = 0; j < n_eval; j++) site_target[j] += source[j] * eval_p[j];
+					}
+				}
+			}
+		}
+	}
+}
+
+int TransferMatrix::sweep() {
+	/* Start from the empty frontier, with the 1 empty lattice, then add the sites row by row. */
+
+	if (width < 1 || width > MAX_STRIP_WIDTH || length < 1) {
+		cout << "ERROR: Transfer matrix width must be between 1 and " << MAX_STRIP_WIDTH << endl;
+		return -1;
+	}
+
+	FrontierState empty = { 0, 0 };
+	tables[0].clear();
+	int n_start = eval_p == NULL ? 1 : n_eval;
+	double* start = tables[0].find(empty, n_start);
+	for (int j = 0; j < n_start; j++) start[j] = 1;
+
+	max_states = 1;
+	for (int x = 0; x < length; x++) {
+		for (int y = 0; y < width; y++) {
+			tables[1].clear();
+			add_site(tables[0], tables[1], x, y);
+			swap(tables[0], tables[1]);
+			if ((int)tables[0].states.size() > max_states) max_states = (int)tables[0].states.size();
+		}
+	}
+	return max_states;
+}
+
+int TransferMatrix::spanning_label(const FrontierState& state) {
+	/* At the end, the frontier is the bottom row, so a label on it with the top, left & right flags spans. There's at most 1 such label. */
+	for (int l = 1; l <= MAX_STRIP_WIDTH; l++) {
+		if ((int)((state.flags >> (3 * (l - 1))) & 7) == (TM_TOP | TM_LEFT | TM_RIGHT)) return l;
+	}
+	return 0;
+}
+
+int TransferMatrix::calculate() {
+	eval_p = NULL;
+	n_eval = 0;
+
+	if (sweep() < 0) return -1;
+
+	for (int n = 0; n <= n_sites; n++) {
+		spanning_count[n] = 0;
+		spanning_size[n] = 0;
+	}
+
+	int l;
+	const double* sums;
+	for (size_t k = 0; k < tables[0].states.size(); k++) {
+		l = spanning_label(tables[0].states[k]);
+		if (l == 0) continue;
+		sums = &tables[0].sums[tables[0].offsets[k]];
+		for (int n = 0; n <= n_sites; n++) {
+			spanning_count[n] += sums[n];
+			spanning_size[n] += sums[(size_t)l * (n_sites + 1) + n];
+		}
+	}
+
+	return max_states;
+}
+
+int TransferMatrix::evaluate(const double* p, int n_p, double* P, double* P_infinity) {
+	/* Same sweep, but with each lattice weighted by p^n (1-p)^(N-n) as it goes, so the spanning states add up to the probabilities directly. */
+
+	eval_p = p;
+	n_eval = n_p;
+
+	int result = sweep();
+	eval_p = NULL;
+	if (result < 0) return -1;
+
+	for (int j = 0; j < n_p; j++) {
+		P[j] = 0;
+		P_infinity[j] = 0;
+	}
+
+	int l;
+	const double* sums;
+	for (size_t k = 0; k < tables[0].states.size(); k++) {
+		l = spanning_label(tables[0].states[k]);
+		if (l == 0) continue;
+		sums = &tables[0].sums[tables[0].offsets[k]];
+		for (int j = 0; j < n_p; j++) {
+			P[j] += sums[j];
+			P_infinity[j] += sums[(size_t)l * n_p + j] / n_sites;
+		}
+	}
+
+	return result;
+}
+
+
+
+double TransferMatrix::get_spanning_count(int n) {
+	if (n < 0 || n > n_sites) return 0;
+	return spanning_count[n];
+}
+
+double TransferMatrix::get_spanning_size(int n) {
+	if (n < 0 || n > n_sites) return 0;
+	return spanning_size[n];
+}
+
+double TransferMatrix::weight(int n, double p) {
+	/* Done with logs, as p^n (1-p)^(N-n) underflows long before the coefficients overflow. */
+	if (p <= 0) return n == 0 ? 1 : 0;
+	if (p >= 1) return n == n_sites ? 1 : 0;
+	return exp(n*log(p) + (n_sites - n)*log(1 - p));
+}
+
+double TransferMatrix::spanning_probability(double p) {
+	double total = 0;
+	for (int n = 0; n <= n_sites; n++) {
+		if (spanning_count[n] > 0) total += spanning_count[n] * weight(n, p);
+	}
+	return total;
+}
+
+double TransferMatrix::P_infinity(double p) {
+	double total = 0;
+	for (int n = 1; n <= n_sites; n++) {
+		if (spanning_size[n] > 0) total += spanning_size[n] * weight(n, p);
+	}
+	return total / n_sites;
+}
+
+double TransferMatrix::mean_F(double p) {
+	/* F = spanning size / n, so the lattices with n occupied sites add spanning_size[n] / n. Then divide by the spanning probability,
+		as ensemble_F only keeps the lattices that span. */
+
+	double P = spanning_probability(p);
+	if (P <= 0) return -1;
+
+	double total = 0;
+	for (int n = 1; n <= n_sites; n++) {
+		if (spanning_size[n] > 0) total += spanning_size[n] / n * weight(n, p);
+	}
+	return total / P;
+}
+
+double TransferMatrix::mean_pc() {
+	/* generate_lattice occupies sites in a random order, so after n sites every set of n sites is equally likely, and
+		P(spanning after n sites) = spanning_count[n] / (N choose n). pc is n/N for the first n that spans, so
+		mean pc = sum over n of n/N * (P_n - P_(n-1)) = 1 - (1/N) * sum of P_n for n < N. */
+
+	double total = 0, log_choose;
+	for (int n = 0; n < n_sites; n++) {
+		if (spanning_count[n] <= 0) continue;
+		log_choose = lgamma(n_sites + 1.0) - lgamma(n + 1.0) - lgamma(n_sites - n + 1.0);
+		total += exp(log(spanning_count[n]) - log_choose);
+	}
+	return 1 - total / n_sites;
+}
+
+bool TransferMatrix::polynomials_to_file(const char* filename) {
+	ofstream outfile(filename);
+	if (!outfile) {
+		cout << "Failed to create file" << endl;
+		return EXIT_FAILURE;
+	}
+	outfile.precision(17);
+	for (int n = 0; n <= n_sites; n++) {
+		outfile << n << " " << spanning_count[n] << " " << spanning_size[n] << endl;
+	}
+	outfile.close();
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+// Exact site percolation on a narrow lattice, by a transfer matrix instead of random lattices.
+// The lattice is swept 1 site at a time, row by row. The state is the frontier: the last site filled in each column,
+// with which of them are connected (numbered in order of first appearance, so equal partitions hash the same), and which edges
+// each of those clusters has touched so far. Every state keeps, for each number of occupied sites n, how many lattices lead to it,
+// and the total size of each frontier cluster over those lattices.
+//
+// At the end, every lattice with a cluster on all 4 edges (the same spanning as find_spanning_cluster) has been counted, so
+// the spanning probability, the mean F of ensemble_F, and the mean pc of ensemble_lattice are exact polynomials in p.
+// The coefficients are doubles, so they're exact up to rounding.
+//
+// The number of states grows about 10x for every 2 columns. calculate() keeps a polynomial per state, which is fine up to a width of about 10.
+// evaluate() only keeps a number per state for each p asked for, which goes to about 12-13, but can't give F or pc, as those need n.
+
+const int MAX_STRIP_WIDTH = 16; // Labels are packed 4 bits per column into 64 bits.
+
+struct FrontierState {
+	unsigned long long labels; // Cluster label of the frontier site of each column, 4 bits each. 0 is unoccupied.
+	unsigned long long flags; // Top, left & right edge flags of each label, 3 bits each.
+	bool operator==(const FrontierState& other) const { return labels == other.labels && flags == other.flags; }
+};
+
+struct FrontierStateHash {
+	size_t operator()(const FrontierState& s) const { return (size_t)(s.labels * 0x9E3779B97F4A7C15ULL ^ s.flags); }
+};
+
+class TransferMatrix
+{
+private:
+
+	int width; // Sites per row.
+	int length; // Number of rows.
+	int n_sites; // width*length
+	double* spanning_count; // Lattices with n occupied sites that span, for n = 0 ... n_sites.
+	double* spanning_size; // Total size of the spanning cluster over those lattices.
+	int max_states; // Largest number of frontier states at once.
+
+	const double* eval_p; // The p values of evaluate(), or NULL for the polynomials of calculate().
+	int n_eval; // Number of p values.
+
+	// The states after a site, with all of their numbers in 1 pool, so a sweep only allocates while the tables are still growing.
+	struct StateTable {
+		std::unordered_map<FrontierState, int, FrontierStateHash> index; // Position of each state in states.
+		std::vector<FrontierState> states;
+		std::vector<size_t> offsets; // Start of each state's numbers in sums.
+		std::vector<double> sums;
+		void clear(); // Empties the table, keeping its memory.
+		double* find(const FrontierState& state, size_t length); // Numbers of the state, adding it with length zeros if it's new.
+	};
+	StateTable tables[2];
+
+	int sweep(); // Adds every site to the empty lattice, leaving the final states in tables[0]. Returns the largest number of states, or -1 if the width isn't supported.
+	void add_site(StateTable& from, StateTable& to, int x, int y); // Moves every state on by the site (x,y), unoccupied & occupied.
+	int spanning_label(const FrontierState& state); // The label with the top, left & right flags in a final state, or 0 if none.
+	double weight(int n, double p); // p^n (1-p)^(n_sites-n)
+public:
+	TransferMatrix(int width, int length); // Nothing is calculated until calculate() or evaluate().
+	~TransferMatrix();
+	int calculate(); // Sweeps the lattice for the polynomials. Returns the largest number of states at once, or -1 if the width isn't supported.
+	int evaluate(const double* p, int n_p, double* P, double* P_infinity); // Sweeps the lattice for n_p values of p only, saving the spanning probability & P_infinity of each. Same return value.
+
+	int get_width(); // Sites per row.
+	int get_length(); // Number of rows.
+	double get_spanning_count(int n); // Coefficient n of the spanning probability: lattices with n occupied sites that span.
+	double get_spanning_size(int n); // Total size of the spanning cluster over the lattices with n occupied sites that span.
+
+	double spanning_probability(double p); // Probability that a lattice of occupation probability p spans.
+	double P_infinity(double p); // Mean fraction of all sites that are in the spanning cluster.
+	double mean_F(double p); // Mean F over the lattices that span, as in ensemble_F. -1 if none can span.
+	double mean_pc(); // Mean fraction of occupied sites when a spanning cluster first appears, as in ensemble_lattice.
+	bool polynomials_to_file(const char* filename); // Writes n, spanning count & spanning size, 1 line per n.
+};
@@ -0,0 +1,395 @@
+#include "Workspace.h"
+#include "Observables.h"
+#include "Instrumentation.h"
+#include <iostream>
+#include <random>
+#include <algorithm>
+
+using namespace std;
+
+
+Workspace::Workspace(int size, int mode) : size(size), mode(mode), epoch(0), n_labels(1), bonds(NULL), order(NULL) {
+	/*Allocate everything once. Every tag starts at 0, and reset moves the epoch to 1, so everything starts off stale.*/
+
+	sites = new int[size*size];
+	site_epoch = new unsigned int[size*size];
+	cluster_labels = new int[size*size + 1]; // A place for 0, and a label for each site.
+	edges = new int[size*size + 1];
+	label_epoch = new unsigned int[size*size + 1];
+
+	for (int i = 0; i < size*size; i++) site_epoch[i] = 0;
+	for (int i = 0; i < size*size + 1; i++) label_epoch[i] = 0;
+
+	if (mode == BOND_MODE) {
+		bonds = new BondLattice(size);
+
+		// Any order of the bonds will do to start with, as each Newman-Ziff run shuffles it as it goes.
+		order = new int[bonds->n_bonds()];
+		int n = 0;
+		for (int bond = 0; bond < 2 * size*size; bond++) {
+			if (bonds->exists(bond)) {
+				order[n] = bond;
+				n++;
+			}
+		}
+	}
+
+	reset();
+}
+
+Workspace::~Workspace() {
+	/*Release everything.*/
+	delete[] sites;
+	delete[] site_epoch;
+	delete[] cluster_labels;
+	delete[] edges;
+	delete[] label_epoch;
+	delete bonds;
+	delete[] order;
+}
+
+int Workspace::get_size() {
+	return size;
+}
+
+int Workspace::get_mode() {
+	return mode;
+}
+
+void Workspace::reset() {
+	/* Moving to the next epoch makes every tag stale at once.
+		When the epoch wraps around after 2^32 realizations, the tags really are cleared, so that an old tag can't match by accident. */
+
+	epoch++;
+	if (epoch == 0) {
+		for (int i = 0; i < size*size; i++) site_epoch[i] = 0;
+		for (int i = 0; i < size*size + 1; i++) label_epoch[i] = 0;
+		epoch = 1;
+	}
+
+	// Label 0 is kept for unoccupied sites.
+	cluster_labels[0] = 0;
+	edges[0] = 0;
+	label_epoch[0] = epoch;
+
+	n_labels = 1;
+}
+
+int Workspace::get_site(int x, int y) {
+	/*A stale site is unoccupied.*/
+	int i = x*size + y;
+	if (site_epoch[i] != epoch) return 0;
+	return sites[i];
+}
+
+void Workspace::set_site(int x, int y, int label) {
+	int i = x*size + y;
+	sites[i] = label;
+	site_epoch[i] = epoch;
+}
+
+void Workspace::touch(int c) {
+	/* A stale label is the proper label of a cluster made of site (c - 1) on its own. */
+	if (label_epoch[c] == epoch) return;
+	cluster_labels[c] = 1;
+	edges[c] = edge_mask((c - 1) / size, (c - 1) % size, size);
+	label_epoch[c] = epoch;
+}
+
+int Workspace::new_label(int x, int y) {
+	/* Hand out the next label, written now, so it never depends on its tag. */
+	int c = n_labels;
+	n_labels++;
+	cluster_labels[c] = 1;
+	edges[c] = edge_mask(x, y, size);
+	label_epoch[c] = epoch;
+	return c;
+}
+
+int Workspace::get_n_labels() {
+	return n_labels;
+}
+
+int* Workspace::get_cluster_labels() {
+	return cluster_labels;
+}
+
+int Workspace::find(int c) {
+	/* Same as find_proper_label, but stale labels are proper labels, and the path is compressed with a second walk instead of a list,
+		so nothing is allocated. Every label on the path ends up as a most direct reference. */
+
+	int root = c;
+	int steps = 0;
+	while (label_epoch[root] == epoch && cluster_labels[root] < 0) { // Stale labels are proper labels.
+		root = -cluster_labels[root];
+		steps++;
+	}
+
+	// Second walk: point everything on the path straight at the proper label.
+	int next;
+	while (c != root) {
+		next = -cluster_labels[c];
+		cluster_labels[c] = -root;
+		c = next;
+	}
+
+	INSTRUMENT_COUNT(FIND_PROPER_LABEL_CALLS, 1);
+	INSTRUMENT_COUNT(FIND_PROPER_LABEL_STEPS, steps);
+
+	return root;
+}
+
+int Workspace::merge(int a, int b) {
+	/* Same as merge_clusters, but the edges are joined too. */
+
+	a = find(a);
+	b = find(b);
+	if (a == b) return a; // Already the same cluster.
+
+	if (b < a) swap(a, b); // Keep the smaller label.
+	touch(a);
+	touch(b);
+
+	cluster_labels[a] += cluster_labels[b];
+	edges[a] |= edges[b];
+	cluster_labels[b] = -a;
+
+	INSTRUMENT_COUNT(UNIONS, 1);
+
+	return a;
+}
+
+void Workspace::add_site(int c, int x, int y) {
+	touch(c);
+	cluster_labels[c]++;
+	edges[c] |= edge_mask(x, y, size);
+}
+
+int Workspace::cluster_size(int c) {
+	touch(c);
+	return cluster_labels[c];
+}
+
+int Workspace::cluster_edges(int c) {
+	touch(c);
+	return edges[c];
+}
+
+BondLattice* Workspace::get_bonds() {
+	return bonds;
+}
+
+int* Workspace::get_order() {
+	return order;
+}
+
+
+
+int find_spanning_cluster(Workspace &W) {
+	/* Every spanning cluster touches the top edge, so only the clusters on the top edge need to be checked.
+		Each root knows the edges its cluster touches, so it's a spanning cluster if they're all 4 of them. */
+
+	int size = W.get_size();
+	int label;
+
+	INSTRUMENT_COUNT(SPANNING_CHECKS, 1);
+	INSTRUMENT_COUNT(EDGE_SITES_SCANNED, size);
+
+	for (int j = 0; j < size; j++) {
+		if (W.get_site(0, j) == 0) continue;
+		label = W.find(W.get_site(0, j));
+		if (W.cluster_edges(label) == ALL_EDGES) return label;
+	}
+
+	return 0;
+}
+
+
+
+double F_calculation(Workspace &W, const double p, mt19937 &mt_rand) {
+	/* The same lattice as F_calculation makes from the same random numbers, as randreal is called for the sites in the same order.
+		Each occupied site gets its own label, and then it's linked to its occupied neighbours to the left & above. */
+
+	W.reset();
+	int size = W.get_size();
+
+	// Make lattice of occupation probability p. Unoccupied sites are just left stale.
+	INSTRUMENT_PHASE_BEGIN(PHASE_GENERATE);
+	for (int i = 0; i < size; i++) {
+		for (int j = 0; j < size; j++) {
+			if (randreal(mt_rand, p)) W.set_site(i, j, W.new_label(i, j));
+		}
+	}
+	INSTRUMENT_PHASE_END(PHASE_GENERATE);
+
+	INSTRUMENT_PHASE_BEGIN(PHASE_LABEL);
+	for (int i = 0; i < size; i++) {
+		for (int j = 0; j < size; j++) {
+			if (W.get_site(i, j) == 0) continue;
+			if (j != 0 && W.get_site(i, j - 1) != 0) W.merge(W.get_site(i, j - 1), W.get_site(i, j));
+			if (i != 0 && W.get_site(i - 1, j) != 0) W.merge(W.get_site(i - 1, j), W.get_site(i, j));
+		}
+	}
+	INSTRUMENT_PHASE_END(PHASE_LABEL);
+
+	INSTRUMENT_PHASE_BEGIN(PHASE_MEASURE);
+	int spanning_cluster = find_spanning_cluster(W);
+
+	//Error handling if no spanning cluster was made.
+	if (spanning_cluster == 0) {
+		INSTRUMENT_PHASE_END(PHASE_MEASURE);
+		return -1;
+	}
+
+	FObserver F;
+	ObservablePipeline pipeline;
+	pipeline.add(&F);
+	pipeline.run(W.get_cluster_labels(), W.get_n_labels(), spanning_cluster, size*size);
+	INSTRUMENT_PHASE_END(PHASE_MEASURE);
+
+	return F.get_F();
+}
+
+
+
+double generate_lattice(Workspace &W, mt19937 &mt_rand) {
+	/* The same algorithm as generate_lattice: sites are occupied at random until a spanning cluster appears.
+		A new site joins the cluster with the smallest proper label around it, and the other clusters around it are merged into that one.
+		Spanning can only start when a site joins a cluster, and the root of that cluster knows its edges, so it's checked in O(1) after every site. */
+
+	W.reset();
+	int size = W.get_size();
+
+	int x, y; // Placeholders for randomly generated indexes
+	int neighbours[N_NEIGHBOURS]; // Proper labels of the neighbouring clusters.
+	int n_neighbours;
+	int label;
+	int n_occupied = 0;
+
+	// Occupying & labelling happen together here, so they're both timed as the generate phase.
+	INSTRUMENT_PHASE_BEGIN(PHASE_GENERATE);
+	while (true) {
+
+		do { x = random(mt_rand, size); y = random(mt_rand, size); } while (W.get_site(x, y) != 0); // Keeps generating random x & y until we find an unoccupied site.
+		n_occupied++;
+
+		n_neighbours = 0;
+		if (x != 0 && W.get_site(x - 1, y) != 0) neighbours[n_neighbours++] = W.find(W.get_site(x - 1, y));
+		if (x != size - 1 && W.get_site(x + 1, y) != 0) neighbours[n_neighbours++] = W.find(W.get_site(x + 1, y));
+		if (y != 0 && W.get_site(x, y - 1) != 0) neighbours[n_neighbours++] = W.find(W.get_site(x, y - 1));
+		if (y != size - 1 && W.get_site(x, y + 1) != 0) neighbours[n_neighbours++] = W.find(W.get_site(x, y + 1));
+
+		if (n_neighbours == 0) { // It's a new cluster
+			W.set_site(x, y, W.new_label(x, y));
+			continue; // A single site can't touch all 4 edges.
+		}
+
+		// Join the cluster with the smallest label, then merge the rest into it.
+		label = *min_element(neighbours, neighbours + n_neighbours);
+		W.set_site(x, y, label);
+		W.add_site(label, x, y);
+		for (int i = 0; i < n_neighbours; i++) label = W.merge(label, neighbours[i]);
+
+		if (W.cluster_edges(label) == ALL_EDGES) break; // Spanning cluster found.
+	}
+	INSTRUMENT_PHASE_END(PHASE_GENERATE);
+
+	// pc = occupied sites / total sites.
+	return (double)n_occupied / (size*size);
+}
+
+
+
+double bond_F_calculation(Workspace &W, const double p, mt19937 &mt_rand) {
+	/* Same as bond_F_calculation, with the bonds & labels kept in W. The planes are cleared, which is only size*size/32 words. */
+
+	if (W.get_mode() != BOND_MODE) {
+		cout << "ERROR: Workspace is not in bond mode" << endl;
+		return -1;
+	}
+
+	W.reset();
+	int size = W.get_size();
+	BondLattice* B = W.get_bonds();
+
+	INSTRUMENT_PHASE_BEGIN(PHASE_GENERATE);
+	B->clear();
+	B->fill(p, mt_rand);
+	INSTRUMENT_PHASE_END(PHASE_GENERATE);
+
+	// Label every site touching an open bond, and join along the open bonds to the left & above, as in label_bond_lattice.
+	INSTRUMENT_PHASE_BEGIN(PHASE_LABEL);
+	for (int i = 0; i < size; i++) {
+		for (int j = 0; j < size; j++) {
+			if (B->isolated(i, j)) continue;
+			W.set_site(i, j, W.new_label(i, j));
+			if (j != 0 && B->horizontal_open(i, j - 1)) W.merge(W.get_site(i, j - 1), W.get_site(i, j));
+			if (i != 0 && B->vertical_open(i - 1, j)) W.merge(W.get_site(i - 1, j), W.get_site(i, j));
+		}
+	}
+	INSTRUMENT_PHASE_END(PHASE_LABEL);
+
+	INSTRUMENT_PHASE_BEGIN(PHASE_MEASURE);
+	int spanning_cluster = find_spanning_cluster(W);
+
+	if (spanning_cluster == 0) {
+		INSTRUMENT_PHASE_END(PHASE_MEASURE);
+		return -1;
+	}
+
+	FObserver F;
+	ObservablePipeline pipeline;
+	pipeline.add(&F);
+	pipeline.run(W.get_cluster_labels(), W.get_n_labels(), spanning_cluster, size*size);
+	INSTRUMENT_PHASE_END(PHASE_MEASURE);
+
+	return F.get_F();
+}
+
+
+
+double generate_bond_lattice(Workspace &W, mt19937 &mt_rand) {
+	/* Same as generate_bond_lattice. Site s is label s + 1, and its label starts stale, so that it's already a cluster of 1 site touching the right edges.
+		The list of bonds left over from the last run is still a list of every bond, so it's shuffled again as it is. */
+
+	if (W.get_mode() != BOND_MODE) {
+		cout << "ERROR: Workspace is not in bond mode" << endl;
+		return -1;
+	}
+
+	int size = W.get_size();
+	if (size < 2) {
+		cout << "ERROR: Bond lattice needs size > 1" << endl;
+		return -1;
+	}
+
+	W.reset();
+	BondLattice* B = W.get_bonds();
+	B->clear();
+	int* order = W.get_order();
+	int n_bonds = B->n_bonds();
+
+	int n_open = 0; // Number of bonds opened so far.
+	int bond, site, a, b;
+
+	INSTRUMENT_PHASE_BEGIN(PHASE_GENERATE);
+	while (n_open < n_bonds) {
+
+		// Fisher-Yates: pick the next bond at random from the ones not yet opened.
+		swap(order[n_open], order[n_open + random(mt_rand, n_bonds - n_open)]);
+		bond = order[n_open];
+		B->open(bond);
+		n_open++;
+
+		site = bond % (size*size);
+		a = site + 1;
+		if (bond < size*size) b = site + 2; // Horizontal: (x,y+1)
+		else b = site + size + 1; // Vertical: (x+1,y)
+
+		if (W.cluster_edges(W.merge(a, b)) == ALL_EDGES) break; // Spanning cluster found.
+	}
+	INSTRUMENT_PHASE_END(PHASE_GENERATE);
+
+	// pc = open bonds / total bonds.
+	return (double)n_open / n_bonds;
+}
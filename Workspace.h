@@ -0,0 +1,66 @@
+#pragma once
+#include "Bond.h"
+#include <random>
+
+// Everything one realization needs, allocated once per (size, mode) and reused for every realization of an ensemble.
+// Starting a new realization is O(1): each site & each label carries the epoch it was last written in, and anything written in an
+// older epoch reads as if it had just been initialised. So a site from an older epoch is unoccupied, and a label from an older epoch
+// is the proper label of a cluster made of site (label - 1) on its own, which is what bond percolation starts from.
+// Labels handed out by new_label are written when they're handed out, so for them the tag never matters.
+
+const int SITE_MODE = 0; // Site percolation
+const int BOND_MODE = 1; // Bond percolation. Also keeps a BondLattice & a list of bonds for the Newman-Ziff order.
+
+class Workspace
+{
+private:
+
+	int size; // Length of each side of the lattice.
+	int mode; // SITE_MODE or BOND_MODE
+	unsigned int epoch; // Number of the current realization. Tags that don't match it are stale.
+
+	int* sites; // Assigned label of each site, x*size+y, or 0 if unoccupied.
+	unsigned int* site_epoch; // Epoch each site was last written in.
+
+	int* cluster_labels; // Same convention as everywhere else: a negative entry references another label, and a proper label holds the size of its cluster.
+	int* edges; // Edges touched by each cluster, while its label is proper.
+	unsigned int* label_epoch; // Epoch each label was last written in.
+	int n_labels; // Next label to hand out with new_label.
+
+	BondLattice* bonds; // Only in BOND_MODE.
+	int* order; // Only in BOND_MODE. Every bond that exists, in the order the last Newman-Ziff run opened them.
+
+	void touch(int c); // Makes label c current, initialising it if it's stale.
+public:
+	Workspace(int size, int mode); // Allocates everything for lattices of this size.
+	~Workspace(); // Releases everything.
+	int get_size(); // Length of each side of the lattice.
+	int get_mode(); // SITE_MODE or BOND_MODE
+	void reset(); // Starts a new realization: every site unoccupied, every label its own single-site cluster. O(1).
+
+	int get_site(int x, int y); // Assigned label of (x,y), or 0 if it's unoccupied in this realization.
+	void set_site(int x, int y, int label); // Sets the assigned label of (x,y).
+
+	int new_label(int x, int y); // Hands out the next label, as a new cluster holding only (x,y).
+	int get_n_labels(); // Labels handed out so far are [1, get_n_labels()).
+	int* get_cluster_labels(); // The label table, for observers. Only valid for labels handed out by new_label.
+
+	int find(int c); // Proper label of label c, with path compression. Never allocates.
+	int merge(int a, int b); // Joins the clusters of labels a & b under the smaller proper label, and returns it.
+	void add_site(int c, int x, int y); // Adds site (x,y) to the cluster with proper label c.
+	int cluster_size(int c); // Size of the cluster with proper label c.
+	int cluster_edges(int c); // Edges touched by the cluster with proper label c.
+
+	BondLattice* get_bonds(); // The bond lattice, or NULL in SITE_MODE.
+	int* get_order(); // The list of bonds, or NULL in SITE_MODE.
+};
+
+int find_spanning_cluster(Workspace &W); // Proper label of the cluster touching all 4 edges, or 0. Checks the edges kept in the cluster roots along the top edge.
+
+double F_calculation(Workspace &W, const double p, std::mt19937 &mt_rand); // Same as F_calculation, reusing W. Same lattices for the same random numbers.
+
+double generate_lattice(Workspace &W, std::mt19937 &mt_rand); // Same as generate_lattice, reusing W. Same pc for the same random numbers.
+
+double bond_F_calculation(Workspace &W, const double p, std::mt19937 &mt_rand); // Same as bond_F_calculation, reusing W, which must be in BOND_MODE.
+
+double generate_bond_lattice(Workspace &W, std::mt19937 &mt_rand); // Same as generate_bond_lattice, reusing W, which must be in BOND_MODE.